@@ -0,0 +1,504 @@
+/*
+	Anim - Skeletal animation and skinning
+*/
+
+/* Includes */
+#include <math.h>
+#include <memory.h>
+#include <xmmintrin.h>
+#include "anim.h"
+#include "job.h"
+
+/* Identity local transform */
+static float anim_identity[ANIM_LOCAL] = {0.0f,0.0f,0.0f,0.0f,0.0f,0.0f,1.0f,1.0f,1.0f,1.0f};
+
+/* Builds a bone matrix from a local transform (scale, then rotate, then translate) */
+static void anim_compose(float *l,float *m)
+{
+	float x,y,z,w,*s;
+	x = l[3];
+	y = l[4];
+	z = l[5];
+	w = l[6];
+	s = &l[7];
+	m[0] = (1.0f-2.0f*(y*y+z*z))*s[0];
+	m[1] = (2.0f*(x*y-w*z))*s[1];
+	m[2] = (2.0f*(x*z+w*y))*s[2];
+	m[3] = l[0];
+	m[4] = (2.0f*(x*y+w*z))*s[0];
+	m[5] = (1.0f-2.0f*(x*x+z*z))*s[1];
+	m[6] = (2.0f*(y*z-w*x))*s[2];
+	m[7] = l[1];
+	m[8] = (2.0f*(x*z-w*y))*s[0];
+	m[9] = (2.0f*(y*z+w*x))*s[1];
+	m[10] = (1.0f-2.0f*(x*x+y*y))*s[2];
+	m[11] = l[2];
+}
+
+/* Multiplies bone matrices (o = a*b, o must not be a or b) */
+static void anim_multiply(float *a,float *b,float *o)
+{
+	int r;
+	for(r = 0;r < 3;r++)
+	{
+		o[r*4] = a[r*4]*b[0]+a[r*4+1]*b[4]+a[r*4+2]*b[8];
+		o[r*4+1] = a[r*4]*b[1]+a[r*4+1]*b[5]+a[r*4+2]*b[9];
+		o[r*4+2] = a[r*4]*b[2]+a[r*4+1]*b[6]+a[r*4+2]*b[10];
+		o[r*4+3] = a[r*4]*b[3]+a[r*4+1]*b[7]+a[r*4+2]*b[11]+a[r*4+3];
+	}
+}
+
+/* Inverts a bone matrix */
+static void anim_invert(float *m,float *o)
+{
+	float d;
+	/* Inverse of the 3x3 part by cofactors */
+	o[0] = m[5]*m[10]-m[6]*m[9];
+	o[1] = m[2]*m[9]-m[1]*m[10];
+	o[2] = m[1]*m[6]-m[2]*m[5];
+	o[4] = m[6]*m[8]-m[4]*m[10];
+	o[5] = m[0]*m[10]-m[2]*m[8];
+	o[6] = m[2]*m[4]-m[0]*m[6];
+	o[8] = m[4]*m[9]-m[5]*m[8];
+	o[9] = m[1]*m[8]-m[0]*m[9];
+	o[10] = m[0]*m[5]-m[1]*m[4];
+	d = m[0]*o[0]+m[1]*o[4]+m[2]*o[8];
+	if(d == 0.0f)
+	{
+		memset(o,0,sizeof(float)*ANIM_MATRIX);
+		return;
+	}
+	d = 1.0f/d;
+	o[0] *= d; o[1] *= d; o[2] *= d;
+	o[4] *= d; o[5] *= d; o[6] *= d;
+	o[8] *= d; o[9] *= d; o[10] *= d;
+	/* Then undo the translation */
+	o[3] = -(o[0]*m[3]+o[1]*m[7]+o[2]*m[11]);
+	o[7] = -(o[4]*m[3]+o[5]*m[7]+o[6]*m[11]);
+	o[11] = -(o[8]*m[3]+o[9]*m[7]+o[10]*m[11]);
+}
+
+/* New skeleton */
+Skeleton :: Skeleton(int n)
+{
+	int i;
+	if(n < 0)
+		n = 0;
+	if(n > ANIM_MAX_BONES)
+		n = ANIM_MAX_BONES;
+	bone_count = n;
+	parents = new int[n];
+	binds = new float[n*ANIM_LOCAL];
+	inverses = new float[n*ANIM_MATRIX];
+	for(i = 0;i < n;i++)
+	{
+		parents[i] = -1;
+		memcpy(&binds[i*ANIM_LOCAL],anim_identity,sizeof(anim_identity));
+		anim_compose(anim_identity,&inverses[i*ANIM_MATRIX]);
+	}
+}
+
+/* Delete skeleton */
+Skeleton :: ~Skeleton()
+{
+	delete[] parents;
+	delete[] binds;
+	delete[] inverses;
+}
+
+/* Set bone */
+int Skeleton :: set_bone(int b,int p,float *t,float *q,float *s)
+{
+	float *l;
+	if(b < 0 || b >= bone_count)
+		return ANIM_ERROR_BONE;
+	if(p >= b || p < -1)
+		return ANIM_ERROR_PARENT;
+	parents[b] = p;
+	l = &binds[b*ANIM_LOCAL];
+	memcpy(&l[ANIM_TRANSLATION],t,sizeof(float)*3);
+	memcpy(&l[ANIM_ROTATION],q,sizeof(float)*4);
+	memcpy(&l[ANIM_SCALE],s,sizeof(float)*3);
+	return 0;
+}
+
+/* Find inverse binds */
+void Skeleton :: finish()
+{
+	float *worlds,local[ANIM_MATRIX];
+	int i;
+	worlds = new float[bone_count*ANIM_MATRIX];
+	for(i = 0;i < bone_count;i++)
+	{
+		if(parents[i] < 0)
+			anim_compose(&binds[i*ANIM_LOCAL],&worlds[i*ANIM_MATRIX]);
+		else
+		{
+			anim_compose(&binds[i*ANIM_LOCAL],local);
+			anim_multiply(&worlds[parents[i]*ANIM_MATRIX],local,&worlds[i*ANIM_MATRIX]);
+		}
+		anim_invert(&worlds[i*ANIM_MATRIX],&inverses[i*ANIM_MATRIX]);
+	}
+	delete[] worlds;
+}
+
+/* Get bone count */
+int Skeleton :: get_bone_count()
+{
+	return bone_count;
+}
+
+/* Get parent */
+int Skeleton :: get_parent(int b)
+{
+	return parents[b];
+}
+
+/* Get bind transform */
+float *Skeleton :: get_bind(int b)
+{
+	return &binds[b*ANIM_LOCAL];
+}
+
+/* Get inverse bind matrix */
+float *Skeleton :: get_inverse(int b)
+{
+	return &inverses[b*ANIM_MATRIX];
+}
+
+/* New pose */
+Pose :: Pose(Skeleton *s)
+{
+	int n;
+	skeleton = s;
+	n = s->get_bone_count();
+	locals = new float[n*ANIM_LOCAL];
+	worlds = new float[n*ANIM_MATRIX];
+	matrices = new float[n*ANIM_MATRIX];
+	reset();
+	build();
+}
+
+/* Delete pose */
+Pose :: ~Pose()
+{
+	delete[] locals;
+	delete[] worlds;
+	delete[] matrices;
+}
+
+/* Back to bind pose */
+void Pose :: reset()
+{
+	int i;
+	for(i = 0;i < skeleton->get_bone_count();i++)
+		memcpy(&locals[i*ANIM_LOCAL],skeleton->get_bind(i),sizeof(float)*ANIM_LOCAL);
+}
+
+/* Blend poses */
+void Pose :: blend(Pose *a,Pose *b,float w)
+{
+	float *la,*lb,*l;
+	int i,j;
+	for(i = 0;i < skeleton->get_bone_count();i++)
+	{
+		la = a->get_local(i);
+		lb = b->get_local(i);
+		l = &locals[i*ANIM_LOCAL];
+		for(j = 0;j < 3;j++)
+		{
+			l[ANIM_TRANSLATION+j] = la[ANIM_TRANSLATION+j]+(lb[ANIM_TRANSLATION+j]-la[ANIM_TRANSLATION+j])*w;
+			l[ANIM_SCALE+j] = la[ANIM_SCALE+j]+(lb[ANIM_SCALE+j]-la[ANIM_SCALE+j])*w;
+		}
+		Anim::nlerp(&la[ANIM_ROTATION],&lb[ANIM_ROTATION],w,&l[ANIM_ROTATION]);
+	}
+}
+
+/* Build matrices */
+void Pose :: build()
+{
+	float local[ANIM_MATRIX];
+	int i,p;
+	for(i = 0;i < skeleton->get_bone_count();i++)
+	{
+		p = skeleton->get_parent(i);
+		if(p < 0)
+			anim_compose(&locals[i*ANIM_LOCAL],&worlds[i*ANIM_MATRIX]);
+		else
+		{
+			anim_compose(&locals[i*ANIM_LOCAL],local);
+			anim_multiply(&worlds[p*ANIM_MATRIX],local,&worlds[i*ANIM_MATRIX]);
+		}
+		anim_multiply(&worlds[i*ANIM_MATRIX],skeleton->get_inverse(i),&matrices[i*ANIM_MATRIX]);
+	}
+}
+
+/* Get local transform */
+float *Pose :: get_local(int b)
+{
+	return &locals[b*ANIM_LOCAL];
+}
+
+/* Get world matrix */
+float *Pose :: get_world(int b)
+{
+	return &worlds[b*ANIM_MATRIX];
+}
+
+/* Get skinning matrices */
+float *Pose :: get_matrices()
+{
+	return matrices;
+}
+
+/* Get skeleton */
+Skeleton *Pose :: get_skeleton()
+{
+	return skeleton;
+}
+
+/* New clip */
+Clip :: Clip(int n)
+{
+	if(n < 0)
+		n = 0;
+	tracks = new AnimTrack[n];
+	track_count = 0;
+	track_capacity = n;
+	length = 0.0f;
+}
+
+/* Delete clip */
+Clip :: ~Clip()
+{
+	delete[] tracks;
+}
+
+/* Add track */
+int Clip :: add_track(int bone,int channel,int n,float *times,float *values)
+{
+	AnimTrack *t;
+	if(track_count >= track_capacity)
+		return ANIM_ERROR_FULL;
+	if(bone < 0 || bone >= ANIM_MAX_BONES || n <= 0)
+		return ANIM_ERROR_BONE;
+	t = &tracks[track_count];
+	t->bone = bone;
+	t->channel = channel;
+	t->key_count = n;
+	t->times = times;
+	t->values = values;
+	if(times[n-1] > length)
+		length = times[n-1];
+	return track_count++;
+}
+
+/* Sample clip */
+void Clip :: sample(float t,Pose *p,int loop)
+{
+	AnimTrack *track;
+	float *a,*b,*o,w;
+	int i,j,lo,hi,mid,width;
+	if(loop && length > 0.0f)
+	{
+		t = fmodf(t,length);
+		if(t < 0.0f)
+			t += length;
+	}
+	for(i = 0;i < track_count;i++)
+	{
+		track = &tracks[i];
+		if(track->bone >= p->get_skeleton()->get_bone_count())
+			continue;
+		width = (track->channel == ANIM_ROTATION) ? 4 : 3;
+		o = &p->get_local(track->bone)[track->channel];
+		/* Hold the ends */
+		if(t <= track->times[0] || track->key_count == 1)
+		{
+			memcpy(o,track->values,sizeof(float)*width);
+			continue;
+		}
+		if(t >= track->times[track->key_count-1])
+		{
+			memcpy(o,&track->values[(track->key_count-1)*width],sizeof(float)*width);
+			continue;
+		}
+		/* Find the keys either side */
+		lo = 0;
+		hi = track->key_count-1;
+		while(hi-lo > 1)
+		{
+			mid = (lo+hi)/2;
+			if(track->times[mid] <= t)
+				lo = mid;
+			else
+				hi = mid;
+		}
+		a = &track->values[lo*width];
+		b = &track->values[hi*width];
+		w = (t-track->times[lo])/(track->times[hi]-track->times[lo]);
+		if(width == 4)
+			Anim::nlerp(a,b,w,o);
+		else
+		{
+			for(j = 0;j < 3;j++)
+				o[j] = a[j]+(b[j]-a[j])*w;
+		}
+	}
+}
+
+/* Get clip length */
+float Clip :: get_length()
+{
+	return length;
+}
+
+/* New skin */
+Skin :: Skin(int pc,float *ps,unsigned char *bs,float *ws)
+{
+	point_count = pc;
+	points = ps;
+	bones = bs;
+	weights = ws;
+	skinned = new float[pc*3];
+	memcpy(skinned,ps,sizeof(float)*pc*3);
+}
+
+/* Delete skin */
+Skin :: ~Skin()
+{
+	delete[] skinned;
+}
+
+/* Skin points */
+void Skin :: apply(Pose *p)
+{
+	__m128 x,y,z,w,m[ANIM_MATRIX],ox,oy,oz;
+	float *mats,*a,*b,*c,*d,*ps,blend[ANIM_MATRIX],out[12];
+	unsigned char *bs;
+	int i,j,k;
+	mats = p->get_matrices();
+	/* Four points at a time, one per lane */
+	for(i = 0;i+4 <= point_count;i += 4)
+	{
+		ps = &points[i*3];
+		x = _mm_set_ps(ps[9],ps[6],ps[3],ps[0]);
+		y = _mm_set_ps(ps[10],ps[7],ps[4],ps[1]);
+		z = _mm_set_ps(ps[11],ps[8],ps[5],ps[2]);
+		/* Blend the bone matrices of each point */
+		for(j = 0;j < ANIM_MATRIX;j++)
+			m[j] = _mm_setzero_ps();
+		bs = &bones[i*ANIM_INFLUENCES];
+		for(k = 0;k < ANIM_INFLUENCES;k++)
+		{
+			w = _mm_set_ps(weights[(i+3)*ANIM_INFLUENCES+k],weights[(i+2)*ANIM_INFLUENCES+k],weights[(i+1)*ANIM_INFLUENCES+k],weights[i*ANIM_INFLUENCES+k]);
+			a = &mats[bs[k]*ANIM_MATRIX];
+			b = &mats[bs[ANIM_INFLUENCES+k]*ANIM_MATRIX];
+			c = &mats[bs[ANIM_INFLUENCES*2+k]*ANIM_MATRIX];
+			d = &mats[bs[ANIM_INFLUENCES*3+k]*ANIM_MATRIX];
+			for(j = 0;j < ANIM_MATRIX;j++)
+				m[j] = _mm_add_ps(m[j],_mm_mul_ps(w,_mm_set_ps(d[j],c[j],b[j],a[j])));
+		}
+		/* Move */
+		ox = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0],x),_mm_mul_ps(m[1],y)),_mm_add_ps(_mm_mul_ps(m[2],z),m[3]));
+		oy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[4],x),_mm_mul_ps(m[5],y)),_mm_add_ps(_mm_mul_ps(m[6],z),m[7]));
+		oz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[8],x),_mm_mul_ps(m[9],y)),_mm_add_ps(_mm_mul_ps(m[10],z),m[11]));
+		/* Back to 3 floats per point */
+		_mm_storeu_ps(&out[0],ox);
+		_mm_storeu_ps(&out[4],oy);
+		_mm_storeu_ps(&out[8],oz);
+		for(j = 0;j < 4;j++)
+		{
+			skinned[(i+j)*3] = out[j];
+			skinned[(i+j)*3+1] = out[4+j];
+			skinned[(i+j)*3+2] = out[8+j];
+		}
+	}
+	/* Leftovers one by one */
+	for(;i < point_count;i++)
+	{
+		memset(blend,0,sizeof(blend));
+		for(k = 0;k < ANIM_INFLUENCES;k++)
+		{
+			a = &mats[bones[i*ANIM_INFLUENCES+k]*ANIM_MATRIX];
+			for(j = 0;j < ANIM_MATRIX;j++)
+				blend[j] += a[j]*weights[i*ANIM_INFLUENCES+k];
+		}
+		ps = &points[i*3];
+		skinned[i*3] = blend[0]*ps[0]+blend[1]*ps[1]+blend[2]*ps[2]+blend[3];
+		skinned[i*3+1] = blend[4]*ps[0]+blend[5]*ps[1]+blend[6]*ps[2]+blend[7];
+		skinned[i*3+2] = blend[8]*ps[0]+blend[9]*ps[1]+blend[10]*ps[2]+blend[11];
+	}
+}
+
+/* Get skinned points */
+float *Skin :: get_points()
+{
+	return skinned;
+}
+
+/* Get point count */
+int Skin :: get_point_count()
+{
+	return point_count;
+}
+
+/* Anim */
+namespace Anim
+{
+	/* Characters handed to skin_all */
+	typedef struct
+	{
+		Skin **skins;
+		Pose **poses;
+	}AnimJob;
+	/* Make quaternion */
+	void quaternion(float angle,float x,float y,float z,float *q)
+	{
+		float l,s;
+		l = (float)sqrt(x*x+y*y+z*z);
+		if(l == 0.0f)
+		{
+			q[0] = q[1] = q[2] = 0.0f;
+			q[3] = 1.0f;
+			return;
+		}
+		angle *= 3.14159265f/360.0f;
+		s = (float)sin(angle)/l;
+		q[0] = x*s;
+		q[1] = y*s;
+		q[2] = z*s;
+		q[3] = (float)cos(angle);
+	}
+	/* Blend quaternions */
+	void nlerp(float *a,float *b,float w,float *q)
+	{
+		float d,l,r[4];
+		int i;
+		/* Take the shorter way round */
+		d = a[0]*b[0]+a[1]*b[1]+a[2]*b[2]+a[3]*b[3];
+		for(i = 0;i < 4;i++)
+			r[i] = a[i]+((d < 0.0f ? -b[i] : b[i])-a[i])*w;
+		l = (float)sqrt(r[0]*r[0]+r[1]*r[1]+r[2]*r[2]+r[3]*r[3]);
+		if(l == 0.0f)
+			l = 1.0f;
+		for(i = 0;i < 4;i++)
+			q[i] = r[i]/l;
+	}
+	/* Build and skin one character */
+	void skin_one(void *data,int item)
+	{
+		AnimJob *j;
+		j = (AnimJob*)data;
+		j->poses[item]->build();
+		j->skins[item]->apply(j->poses[item]);
+	}
+	/* Build and skin characters */
+	void skin_all(int n,Skin **skins,Pose **poses)
+	{
+		AnimJob j;
+		j.skins = skins;
+		j.poses = poses;
+		Job::run(n,skin_one,&j);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,221 @@
+#ifndef ANIM_H
+#define ANIM_H
+
+/* Defines */
+#define ANIM_MAX_BONES 64
+#define ANIM_INFLUENCES 4 /* Bones that move each skinned point */
+#define ANIM_LOCAL 10 /* Floats in a local bone transform (translation 3, rotation quaternion 4, scale 3) */
+#define ANIM_MATRIX 12 /* Floats in a bone matrix (3 rows of 4, the last row is always 0,0,0,1) */
+
+/* Track channels */
+#define ANIM_TRANSLATION 0 /* 3 floats per key */
+#define ANIM_ROTATION 3 /* 4 floats per key (quaternion x,y,z,w) */
+#define ANIM_SCALE 7 /* 3 floats per key */
+
+/* Error codes */
+#define ANIM_ERROR_FULL -1
+#define ANIM_ERROR_BONE -2
+#define ANIM_ERROR_PARENT -3
+
+/* REMARKS: */
+/*
+	A skeleton holds the bones in their bind pose, parents always come before their children.
+	A pose holds a local transform for every bone, clips write into it by sampling their keyframe tracks,
+	and poses can be blended together before build turns them into skinning matrices.
+	A skin moves its points by up to ANIM_INFLUENCES weighted bones each (weights should add up to 1),
+	four points at a time with SSE, and writes them out ready for Geo::draw.
+	Skinned points change every frame, so draw them straight with Geo::draw rather than through a Mesh
+	(whose bounds are only found once).
+	Anim::skin_all builds and skins many characters at once, spread over the Job workers.
+*/
+
+/* Keyframe track of one channel of one bone */
+typedef struct
+{
+	int bone; /* Bone it moves */
+	int channel; /* Track channel */
+	int key_count; /* Count of keys */
+	float *times; /* Time of each key (in seconds, increasing) */
+	float *values; /* Value of each key */
+}AnimTrack;
+
+/* Skeleton */
+class Skeleton
+{
+private:
+	int bone_count; /* Count of bones */
+	int *parents; /* Parent of each bone (-1 for none) */
+	float *binds; /* Local bind transform of each bone */
+	float *inverses; /* Inverse of the world bind matrix of each bone */
+public:
+	/*
+		Creates a skeleton with every bone at the origin
+		n - count of bones (up to ANIM_MAX_BONES)
+	*/
+	Skeleton(int n);
+	~Skeleton();
+	/*
+		Sets a bone in its bind pose
+		Returns result code
+		b - the bone
+		p - parent bone (-1 for none, otherwise lower than b)
+		t - translation (3 floats)
+		q - rotation quaternion (4 floats)
+		s - scale (3 floats)
+	*/
+	int set_bone(int b,int p,float *t,float *q,float *s);
+	/*
+		Works out the inverse bind matrices, call once every bone is set
+	*/
+	void finish();
+	/*
+		Gets skeleton contents
+	*/
+	int get_bone_count();
+	int get_parent(int b);
+	float *get_bind(int b);
+	float *get_inverse(int b);
+};
+
+/* Pose */
+class Pose
+{
+private:
+	Skeleton *skeleton; /* Skeleton posed */
+	float *locals; /* Local transform of each bone */
+	float *worlds; /* World matrix of each bone */
+	float *matrices; /* Skinning matrix of each bone (world times inverse bind) */
+public:
+	/*
+		Creates a pose in the bind pose
+		s - the skeleton
+	*/
+	Pose(Skeleton *s);
+	~Pose();
+	/*
+		Returns every bone to the bind pose
+	*/
+	void reset();
+	/*
+		Sets the pose between two others (of the same skeleton)
+		a,b - the poses
+		w - how far towards b (0 to 1)
+	*/
+	void blend(Pose *a,Pose *b,float w);
+	/*
+		Works out world and skinning matrices from the local transforms
+	*/
+	void build();
+	/*
+		Gets the local transform of a bone, which can be changed directly
+		b - the bone
+	*/
+	float *get_local(int b);
+	/*
+		Gets the world matrix of a bone (as of the last build)
+		b - the bone
+	*/
+	float *get_world(int b);
+	/*
+		Gets the skinning matrices (as of the last build)
+	*/
+	float *get_matrices();
+	Skeleton *get_skeleton();
+};
+
+/* Clip */
+class Clip
+{
+private:
+	AnimTrack *tracks; /* Tracks */
+	int track_count;
+	int track_capacity;
+	float length; /* Time of the last key of any track */
+public:
+	/*
+		Creates an empty clip
+		n - most tracks
+	*/
+	Clip(int n);
+	~Clip();
+	/*
+		Adds a keyframe track, keys are not copied and must outlive the clip
+		Returns the new track or error code
+		bone - bone it moves
+		channel - track channel
+		n - count of keys
+		times - time of each key (in seconds, increasing)
+		values - value of each key (3 or 4 floats depending on channel)
+	*/
+	int add_track(int bone,int channel,int n,float *times,float *values);
+	/*
+		Writes the clip at a time into a pose, channels without tracks are left alone
+		t - time (in seconds)
+		p - the pose
+		loop - 1 to wrap the time around the length of the clip, 0 to hold the ends
+	*/
+	void sample(float t,Pose *p,int loop);
+	/*
+		Gets length of clip (in seconds)
+	*/
+	float get_length();
+};
+
+/* Skin */
+class Skin
+{
+private:
+	int point_count; /* Count of points */
+	float *points; /* Points in bind pose (3 floats each) */
+	unsigned char *bones; /* Bones moving each point (ANIM_INFLUENCES each) */
+	float *weights; /* Weight of each of those bones (ANIM_INFLUENCES each) */
+	float *skinned; /* Moved points (3 floats each) */
+public:
+	/*
+		Creates a skin, the arrays are not copied and must outlive the skin
+		pc - count of points
+		ps - points in bind pose
+		bs - bones moving each point
+		ws - weight of each of those bones
+	*/
+	Skin(int pc,float *ps,unsigned char *bs,float *ws);
+	~Skin();
+	/*
+		Moves the points by a built pose
+		p - the pose
+	*/
+	void apply(Pose *p);
+	/*
+		Gets the moved points (3 floats each) for Geo::draw
+	*/
+	float *get_points();
+	int get_point_count();
+};
+
+/* Anim */
+namespace Anim
+{
+	/*
+		Makes a rotation quaternion
+		angle - rotation (in degrees)
+		x,y,z - axis to rotate around
+		q - output quaternion (4 floats)
+	*/
+	extern void quaternion(float angle,float x,float y,float z,float *q);
+	/*
+		Blends two rotations along the shorter way, normalized
+		a,b - the quaternions
+		w - how far towards b (0 to 1)
+		q - output quaternion (may be a or b)
+	*/
+	extern void nlerp(float *a,float *b,float w,float *q);
+	/*
+		Builds poses and applies them to skins, spread over the Job workers
+		n - count of characters
+		skins - skin of each character
+		poses - pose of each character
+	*/
+	extern void skin_all(int n,Skin **skins,Pose **poses);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,89 @@
+/*
+	Arena - Bump pointer allocator for short lived data
+*/
+
+/* Includes */
+#include <memory.h>
+#include "arena.h"
+
+/* New arena */
+Arena :: Arena(int s)
+{
+	size = (s+ARENA_ALIGN-1)&~(ARENA_ALIGN-1);
+	data = new char[size+ARENA_ALIGN];
+	used = 0;
+	high_water = 0;
+#ifdef ARENA_DEBUG
+	memset(data,ARENA_POISON,size+ARENA_ALIGN);
+#endif
+}
+
+/* Delete arena */
+Arena :: ~Arena()
+{
+	delete[] data;
+	data = 0;
+}
+
+/* Allocate */
+void *Arena :: alloc(int s)
+{
+	char *base;
+	int at;
+	if(s < 0)
+		return 0;
+	/* Record the peak even when it does not fit, so the arena can be sized from it */
+	s = (s+ARENA_ALIGN-1)&~(ARENA_ALIGN-1);
+	if(used+s > high_water)
+		high_water = used+s;
+	if(s > size-used)
+		return 0;
+	/* Bump (data itself might not be aligned, so align the address) */
+	base = (char*)(((size_t)data+ARENA_ALIGN-1)&~(size_t)(ARENA_ALIGN-1));
+	at = used;
+	used += s;
+	return base+at;
+}
+
+/* Get mark */
+int Arena :: get_mark()
+{
+	return used;
+}
+
+/* Rewind to mark */
+void Arena :: rewind(int m)
+{
+	if(m < 0 || m > used)
+		return;
+#ifdef ARENA_DEBUG
+	char *base;
+	base = (char*)(((size_t)data+ARENA_ALIGN-1)&~(size_t)(ARENA_ALIGN-1));
+	memset(base+m,ARENA_POISON,used-m);
+#endif
+	used = m;
+}
+
+/* Release everything */
+void Arena :: reset()
+{
+	rewind(0);
+}
+
+/* Get bytes used */
+int Arena :: get_used()
+{
+	return used;
+}
+
+/* Get size */
+int Arena :: get_size()
+{
+	return size;
+}
+
+/* Get high water mark */
+int Arena :: get_high_water()
+{
+	return high_water;
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+/* Defines */
+#define ARENA_ALIGN 16 /* Every allocation starts on this boundary */
+#define ARENA_POISON 0xCD /* Byte written over freed memory when ARENA_DEBUG is defined */
+
+/* REMARKS: */
+/*
+	An arena hands out memory by bumping a pointer, nothing is freed individually.
+	Everything is released at once with reset, or back to a mark with rewind,
+	which makes it ideal for data that only lives for one frame or one draw.
+	Build with ARENA_DEBUG to poison released memory so stale pointers show up quickly.
+	The high water mark is always kept (including requests that did not fit),
+	use it to size arenas for release builds.
+*/
+
+/* Arena */
+class Arena
+{
+private:
+	char *data; /* Arena memory */
+	int size; /* Size of arena (in bytes) */
+	int used; /* Bytes handed out */
+	int high_water; /* Most bytes ever asked for at once */
+public:
+	/*
+		Allocates a new arena
+		s - size of arena (in bytes)
+	*/
+	Arena(int s);
+	~Arena();
+	/*
+		Hands out memory from the arena
+		Returns 0 if there is not enough room left
+		s - size of memory (in bytes)
+	*/
+	void *alloc(int s);
+	/*
+		Gets a mark of the current position that can later be rewound to
+	*/
+	int get_mark();
+	/*
+		Releases everything handed out since the mark
+		m - mark from get_mark
+	*/
+	void rewind(int m);
+	/*
+		Releases everything
+	*/
+	void reset();
+	/*
+		Gets arena usage (in bytes)
+	*/
+	int get_used();
+	int get_size();
+	int get_high_water();
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,148 @@
+/*
+	Diorama Benchmarks
+	Measures engine kernels against the implementations they replaced
+*/
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "draw.h"
+#include "system.h"
+
+/* Defines */
+#define BENCH_PIXELS 65536 /* Working set of one 256x256 texture */
+#define BENCH_PASSES 256
+
+/* Old blend LUTs, kept here only as the reference to beat */
+unsigned char lut_multiply[256][256];
+unsigned char lut_multiply_inv[256][256];
+void lut_calculate()
+{
+	int x,a;
+	float xf,af;
+	for(x = 0;x < 256;x++)
+	{
+		for(a = 0;a < 256;a++)
+		{
+			xf = ((float)x)/255.0f;
+			af = ((float)a)/255.0f;
+			lut_multiply[x][a] = (unsigned char)(xf*af*255.0f);
+			lut_multiply_inv[x][a] = (unsigned char)(xf*(1.0f-af)*255.0f);
+		}
+	}
+}
+int lut_multiply_color(int c1,int c2)
+{
+	unsigned char *c1b,*c2b;
+	c1b = (unsigned char*)&c1;
+	c2b = (unsigned char*)&c2;
+	c1b[0] = lut_multiply[c1b[0]][c2b[0]];
+	c1b[1] = lut_multiply[c1b[1]][c2b[1]];
+	c1b[2] = lut_multiply[c1b[2]][c2b[2]];
+	c1b[3] = lut_multiply[c1b[3]][c2b[3]];
+	return c1;
+}
+int lut_blend(int c,int s)
+{
+	unsigned char *cb,*sb;
+	cb = (unsigned char*)&c;
+	sb = (unsigned char*)&s;
+	sb[0] = lut_multiply[cb[0]][cb[3]]+lut_multiply_inv[sb[0]][cb[3]];
+	sb[1] = lut_multiply[cb[1]][cb[3]]+lut_multiply_inv[sb[1]][cb[3]];
+	sb[2] = lut_multiply[cb[2]][cb[3]]+lut_multiply_inv[sb[2]][cb[3]];
+	return s;
+}
+
+/* Benchmark data */
+int bench_source[BENCH_PIXELS];
+int bench_dest[BENCH_PIXELS];
+
+/* Exact rounded product of two bytes as fractions of 255 */
+int exact_multiply(int a,int b)
+{
+	return (int)floor(((double)a*(double)b)/255.0+0.5);
+}
+
+/* Checks every byte pair against the exact product */
+void accuracy()
+{
+	int a,b,e,lut_wrong,new_wrong,lut_worst,new_worst,d;
+	lut_wrong = 0;
+	new_wrong = 0;
+	lut_worst = 0;
+	new_worst = 0;
+	for(a = 0;a < 256;a++)
+	{
+		for(b = 0;b < 256;b++)
+		{
+			e = exact_multiply(a,b);
+			d = abs(lut_multiply_color(a,b)-e);
+			if(d) lut_wrong++;
+			if(d > lut_worst) lut_worst = d;
+			d = abs(Draw::multiply_color(a,b)-e);
+			if(d) new_wrong++;
+			if(d > new_worst) new_worst = d;
+		}
+	}
+	printf("multiply accuracy: LUT %d/65536 wrong (worst %d), arithmetic %d/65536 wrong (worst %d)\n",lut_wrong,lut_worst,new_wrong,new_worst);
+}
+
+/* Times a blend kernel over the working set */
+void measure(const char *name,int kind)
+{
+	long long from,took;
+	int pass,i,sum;
+	/* Run every pass over the whole working set */
+	sum = 0;
+	from = System::get_micro();
+	for(pass = 0;pass < BENCH_PASSES;pass++)
+	{
+		switch(kind)
+		{
+		case 0:
+			for(i = 0;i < BENCH_PIXELS;i++)
+				bench_dest[i] = lut_multiply_color(bench_source[i],bench_dest[i]);
+			break;
+		case 1:
+			for(i = 0;i < BENCH_PIXELS;i++)
+				bench_dest[i] = Draw::multiply_color(bench_source[i],bench_dest[i]);
+			break;
+		case 2:
+			for(i = 0;i < BENCH_PIXELS;i++)
+				bench_dest[i] = lut_blend(bench_source[i],bench_dest[i]);
+			break;
+		case 3:
+			for(i = 0;i < BENCH_PIXELS;i++)
+				bench_dest[i] = Draw::blend(0,0,bench_source[i],bench_dest[i]);
+			break;
+		}
+		sum += bench_dest[pass];
+		/* Keep the destination from collapsing to black */
+		bench_dest[pass&(BENCH_PIXELS-1)] |= 0xFFFFFFFF;
+	}
+	took = System::get_micro()-from;
+	if(took <= 0)
+		took = 1;
+	printf("%-24s %8.1f Mpixels/s (%d)\n",name,((double)BENCH_PIXELS*BENCH_PASSES)/(double)took,sum&1);
+}
+
+/* Entry */
+int main(int argn,char **argv)
+{
+	int i;
+	/* Random working set */
+	lut_calculate();
+	for(i = 0;i < BENCH_PIXELS;i++)
+	{
+		bench_source[i] = (rand()<<16)^rand();
+		bench_dest[i] = (rand()<<16)^rand();
+	}
+	/* Blend kernels */
+	accuracy();
+	measure("multiply (LUT)",0);
+	measure("multiply (arithmetic)",1);
+	measure("blend (LUT)",2);
+	measure("blend (arithmetic)",3);
+	return 0;
+}
\ No newline at end of file
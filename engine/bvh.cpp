@@ -0,0 +1,304 @@
+/*
+	Bvh - Bounding volume hierarchy for static things
+*/
+
+/* Includes */
+#include <memory.h>
+#include "bvh.h"
+#include "geo.h"
+
+/* New tree */
+Bvh :: Bvh()
+{
+	nodes = 0;
+	items = 0;
+	boxes = 0;
+	centers = 0;
+	clear();
+}
+
+/* Delete tree */
+Bvh :: ~Bvh()
+{
+	clear();
+}
+
+/* Release tree */
+void Bvh :: clear()
+{
+	if(nodes)
+		delete[] nodes;
+	if(items)
+		delete[] items;
+	if(boxes)
+		delete[] boxes;
+	nodes = 0;
+	items = 0;
+	boxes = 0;
+	node_count = 0;
+	item_count = 0;
+}
+
+/* Fit node box */
+void Bvh :: fit(int n,int first,int count)
+{
+	float *b;
+	int i,j;
+	for(i = 0;i < count;i++)
+	{
+		b = &boxes[items[first+i]*6];
+		for(j = 0;j < 3;j++)
+		{
+			if(i == 0 || b[j] < nodes[n].lo[j]) nodes[n].lo[j] = b[j];
+			if(i == 0 || b[j+3] > nodes[n].hi[j]) nodes[n].hi[j] = b[j+3];
+		}
+	}
+}
+
+/* Build node */
+int Bvh :: split(int n,int first,int count)
+{
+	float e,best,pivot;
+	int i,j,axis,lo,hi,mid,store,t;
+	fit(n,first,count);
+	if(count <= BVH_LEAF_SIZE)
+	{
+		nodes[n].first = first;
+		nodes[n].count = count;
+		return n;
+	}
+	/* Longest axis */
+	axis = 0;
+	best = -1.0f;
+	for(j = 0;j < 3;j++)
+	{
+		e = nodes[n].hi[j]-nodes[n].lo[j];
+		if(e > best)
+		{
+			best = e;
+			axis = j;
+		}
+	}
+	/* Partially sort centers along it until the median item is in place */
+	lo = first;
+	hi = first+count-1;
+	mid = first+count/2;
+	while(lo < hi)
+	{
+		pivot = centers[items[(lo+hi)/2]*3+axis];
+		t = items[(lo+hi)/2];
+		items[(lo+hi)/2] = items[hi];
+		items[hi] = t;
+		store = lo;
+		for(i = lo;i < hi;i++)
+		{
+			if(centers[items[i]*3+axis] < pivot)
+			{
+				t = items[i];
+				items[i] = items[store];
+				items[store] = t;
+				store++;
+			}
+		}
+		t = items[store];
+		items[store] = items[hi];
+		items[hi] = t;
+		if(store == mid)
+			break;
+		if(store < mid)
+			lo = store+1;
+		else
+			hi = store-1;
+	}
+	/* Children sit next to each other */
+	nodes[n].first = node_count;
+	nodes[n].count = 0;
+	node_count += 2;
+	split(nodes[n].first,first,mid-first);
+	split(nodes[n].first+1,mid,first+count-mid);
+	return n;
+}
+
+/* Build tree */
+void Bvh :: build(int n,float *los,float *his)
+{
+	int i,j;
+	clear();
+	if(n <= 0)
+		return;
+	/* Copy boxes */
+	item_count = n;
+	items = new int[n];
+	boxes = new float[n*6];
+	centers = new float[n*3];
+	for(i = 0;i < n;i++)
+	{
+		items[i] = i;
+		for(j = 0;j < 3;j++)
+		{
+			boxes[i*6+j] = los[i*3+j];
+			boxes[i*6+j+3] = his[i*3+j];
+			centers[i*3+j] = (los[i*3+j]+his[i*3+j])*0.5f;
+		}
+	}
+	/* A binary tree with single item leaves at worst has 2n-1 nodes */
+	nodes = new BvhNode[n*2];
+	node_count = 1;
+	split(0,0,n);
+	delete[] centers;
+	centers = 0;
+}
+
+/* Find visible items */
+int Bvh :: query_frustum(int *out,int max)
+{
+	int stack[BVH_MAX_DEPTH*2];
+	int top,found,n,i;
+	BvhNode *node;
+	if(!node_count)
+		return 0;
+	found = 0;
+	top = 0;
+	stack[top++] = 0;
+	while(top > 0)
+	{
+		node = &nodes[stack[--top]];
+		if(Geo::cull_box(node->lo,node->hi))
+			continue;
+		if(!node->count)
+		{
+			stack[top++] = node->first+1;
+			stack[top++] = node->first;
+			continue;
+		}
+		for(i = 0;i < node->count && found < max;i++)
+		{
+			n = items[node->first+i];
+			if(!Geo::cull_box(&boxes[n*6],&boxes[n*6+3]))
+				out[found++] = n;
+		}
+	}
+	return found;
+}
+
+/* Do boxes overlap? */
+static int bvh_overlap(float *alo,float *ahi,float *blo,float *bhi)
+{
+	return alo[0] <= bhi[0] && ahi[0] >= blo[0] &&
+	       alo[1] <= bhi[1] && ahi[1] >= blo[1] &&
+	       alo[2] <= bhi[2] && ahi[2] >= blo[2];
+}
+
+/* Find overlapping items */
+int Bvh :: query_box(float *lo,float *hi,int *out,int max)
+{
+	int stack[BVH_MAX_DEPTH*2];
+	int top,found,n,i;
+	BvhNode *node;
+	if(!node_count)
+		return 0;
+	found = 0;
+	top = 0;
+	stack[top++] = 0;
+	while(top > 0)
+	{
+		node = &nodes[stack[--top]];
+		if(!bvh_overlap(node->lo,node->hi,lo,hi))
+			continue;
+		if(!node->count)
+		{
+			stack[top++] = node->first+1;
+			stack[top++] = node->first;
+			continue;
+		}
+		for(i = 0;i < node->count && found < max;i++)
+		{
+			n = items[node->first+i];
+			if(bvh_overlap(&boxes[n*6],&boxes[n*6+3],lo,hi))
+				out[found++] = n;
+		}
+	}
+	return found;
+}
+
+/* Where does a ray enter a box? (-1 if it misses) */
+static float bvh_enter(float *lo,float *hi,float *o,float *inv)
+{
+	float near,far,a,b,t;
+	int j;
+	near = 0.0f;
+	far = 3.0e38f;
+	for(j = 0;j < 3;j++)
+	{
+		/* Slabs, a zero direction gives infinities which still compare right */
+		a = (lo[j]-o[j])*inv[j];
+		b = (hi[j]-o[j])*inv[j];
+		if(a > b)
+		{
+			t = a;
+			a = b;
+			b = t;
+		}
+		if(a > near) near = a;
+		if(b < far) far = b;
+		if(near > far)
+			return -1.0f;
+	}
+	return near;
+}
+
+/* Find item hit by ray */
+int Bvh :: query_ray(float *o,float *d,float *t)
+{
+	int stack[BVH_MAX_DEPTH*2];
+	int top,best,n,i;
+	float inv[3],near,nearest;
+	BvhNode *node;
+	best = BVH_NONE;
+	if(!node_count)
+		return best;
+	for(i = 0;i < 3;i++)
+		inv[i] = (d[i] != 0.0f) ? 1.0f/d[i] : 3.0e38f;
+	nearest = 3.0e38f;
+	top = 0;
+	stack[top++] = 0;
+	while(top > 0)
+	{
+		node = &nodes[stack[--top]];
+		/* Skip branches entered further away than the nearest hit so far */
+		near = bvh_enter(node->lo,node->hi,o,inv);
+		if(near < 0.0f || near > nearest)
+			continue;
+		if(!node->count)
+		{
+			stack[top++] = node->first+1;
+			stack[top++] = node->first;
+			continue;
+		}
+		for(i = 0;i < node->count;i++)
+		{
+			n = items[node->first+i];
+			near = bvh_enter(&boxes[n*6],&boxes[n*6+3],o,inv);
+			if(near >= 0.0f && near < nearest)
+			{
+				nearest = near;
+				best = n;
+			}
+		}
+	}
+	if(best != BVH_NONE)
+		t[0] = nearest;
+	return best;
+}
+
+/* Get item count */
+int Bvh :: get_item_count()
+{
+	return item_count;
+}
+
+/* Get node count */
+int Bvh :: get_node_count()
+{
+	return node_count;
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#ifndef BVH_H
+#define BVH_H
+
+/* Defines */
+#define BVH_LEAF_SIZE 4 /* Most items kept in one leaf */
+#define BVH_MAX_DEPTH 64 /* Deepest a query ever walks (median splits stay far below this) */
+#define BVH_NONE -1 /* No item */
+
+/* REMARKS: */
+/*
+	A bounding volume hierarchy over the boxes of static things, like the chunks of a level.
+	It is built once (usually at level load) by splitting items at the median of their longest axis,
+	nodes are kept in one flat array with both children of a node next to each other.
+	Queries walk down from the root and skip every branch whose box misses,
+	so they cost about the log of the item count plus the count of items found.
+	The same tree answers visibility (frustum), collision (box) and picking (ray) queries,
+	all of them only look at the boxes and leave exact tests to the caller.
+*/
+
+/* Node of the tree */
+typedef struct
+{
+	float lo[3]; /* Box around everything below */
+	float hi[3];
+	int first; /* First child node, or first item for leaves */
+	int count; /* Count of items (0 for nodes with children) */
+}BvhNode;
+
+/* Bvh */
+class Bvh
+{
+private:
+	BvhNode *nodes; /* Nodes (root first) */
+	int node_count;
+	int *items; /* Item numbers, ordered so every leaf owns a run */
+	int item_count;
+	float *boxes; /* Item boxes (6 floats each, lo then hi) */
+	float *centers; /* Item box centers (3 floats each, only while building) */
+	/*
+		Builds the node for a run of items
+		Returns the node
+	*/
+	int split(int n,int first,int count);
+	/*
+		Fits a node box around a run of items
+	*/
+	void fit(int n,int first,int count);
+public:
+	/*
+		Creates a new empty tree
+	*/
+	Bvh();
+	~Bvh();
+	/*
+		Builds the tree, replacing current contents
+		n - count of items
+		los,his - box corners of each item (3 floats each), item numbers are their positions
+	*/
+	void build(int n,float *los,float *his);
+	/*
+		Releases the tree
+	*/
+	void clear();
+	/*
+		Finds items whose boxes may be seen with the current Geo transform and camera
+		Returns count of items found
+		out - output item numbers
+		max - most items to output
+	*/
+	int query_frustum(int *out,int max);
+	/*
+		Finds items whose boxes overlap a box
+		Returns count of items found
+		lo,hi - box corners (3 floats each)
+		out - output item numbers
+		max - most items to output
+	*/
+	int query_box(float *lo,float *hi,int *out,int max);
+	/*
+		Finds the nearest item whose box a ray hits
+		Returns the item or BVH_NONE
+		o - ray origin (3 floats)
+		d - ray direction (3 floats)
+		t - output distance along the ray where the box is entered (in lengths of d)
+	*/
+	int query_ray(float *o,float *d,float *t);
+	/*
+		Gets counts
+	*/
+	int get_item_count();
+	int get_node_count();
+};
+
+#endif
\ No newline at end of file
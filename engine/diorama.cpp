@@ -12,6 +12,9 @@
 #include "system.h"
 #include "vector.h"
 #include "geo.h"
+#include "stream.h"
+#include "pace.h"
+#include "job.h"
 
 /* Entry */
 float points[] = {-1.0f,-1.0f,0.0f,
@@ -26,12 +29,22 @@ int main(int argn,char **argv)
 	/* Start video */
 	if(Video::start())
 		return -1;
+	/* Start background loading */
+	if(Stream::start(0))
+		return -1;
+	/* Start worker threads */
+	if(Job::start(0))
+		return -1;
 	/* Prepare a test quad */
 	Texture *t = new Texture(32,32);
 	t->make_test_pattern();
+	/* Run at a steady frame rate */
+	Pace::set_target(PACE_DEFAULT_FPS);
 	/* Render quad */
 	while(Video::handle())
 	{
+		/* Finish whatever assets arrived, within budget */
+		Stream::update(STREAM_DEFAULT_BUDGET);
 		if(Video::begin())
 			return -1;
 		Geo::identity();
@@ -40,7 +53,13 @@ int main(int argn,char **argv)
 		Geo::draw(4,points,coords,colors,2,triangles);
 		if(Video::end())
 			return -1;
+		/* Hold to frame rate */
+		Pace::wait();
 	}
+	/* Stop worker threads */
+	Job::stop();
+	/* Stop background loading */
+	Stream::stop();
 	/* Stop video */
 	Video::stop();
 	return 0;
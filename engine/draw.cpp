@@ -5,6 +5,7 @@
 /* Includes */
 #include <stdlib.h>
 #include <memory.h>
+#include <emmintrin.h>
 #include "video.h"
 #include "draw.h"
 
@@ -86,6 +87,12 @@ int Texture :: get_pixel(int x,int y)
 	return data[ux+(uy<<pitch)];
 }
 
+/* Get row */
+int *Texture :: get_row(int y)
+{
+	return &data[(((unsigned int)y)&height_mask)<<pitch];
+}
+
 /* Set pixel */
 void Texture :: set_pixel(int x,int y,int c)
 {
@@ -98,6 +105,12 @@ void Texture :: set_pixel(int x,int y,int c)
 	data[x+y*width] = c;
 }
 
+/* Set all pixels */
+void Texture :: set_data(int *p)
+{
+	memcpy(data,p,sizeof(int)*width*height);
+}
+
 /* Set test pattern */
 void Texture :: make_test_pattern()
 {
@@ -126,43 +139,37 @@ namespace Draw
 {
 	/* Globals */
 	int pixels_filled = 0; /* Number of pixels filled (used to calculate fill rate) */
-	unsigned char blend_multiply[256][256]; /* Multiply operation LUT */
-	unsigned char blend_multiply_inv[256][256]; /* Multiply by one minus alpha LUT */
-	/* Populates multiply blend LUTs */
-	void calculate_multiply()
-	{
-		int x,a;
-		float xf,af,mf,mfi;
-		for(x = 0;x < 256;x++)
-		{
-			for(a = 0;a < 256;a++)
-			{
-				/* Convert to fragment range */
-				xf = (float)x;
-				xf /= 255.0f;
-				af = (float)a;
-				af /= 255.0f;
-				/* Calculate */
-				mf = xf*af;
-				mfi = xf*(1.0f-af);
-				/* Convert back to byte range */
-				mf *= 255.0f;
-				mfi *= 255.0f;
-				blend_multiply[x][a] = (unsigned char)(mf);
-				blend_multiply_inv[x][a] = (unsigned char)(mfi);
-			}
-		}
+	unsigned long long draw_fog = 0; /* Fog color spread into lanes */
+	/* Spreads the four channels of a pixel into 16-bit lanes of one register (red, blue, green, extra) */
+	inline unsigned long long spread(unsigned int c)
+	{
+		return (unsigned long long)(c&0x00FF00FF)|((unsigned long long)(c&0xFF00FF00)<<24);
+	}
+	/* Divides every lane by 255 with rounding and packs the lanes back into a pixel */
+	inline unsigned int gather(unsigned long long x)
+	{
+		x += 0x0080008000800080ULL;
+		x += (x>>8)&0x00FF00FF00FF00FFULL;
+		x = (x>>8)&0x00FF00FF00FF00FFULL;
+		return (unsigned int)((x&0x00FF00FF)|((x>>24)&0xFF00FF00));
 	}
 	/* Draw a texture directly */
 	void texture(int x,int y,Texture *t)
 	{
-		int px,py;
+		int py,from,to;
+		Video::mark_dirty(x,y,t->get_width(),t->get_height());
+		/* Clip columns once, then copy whole rows */
+		from = (x < 0) ? -x : 0;
+		to = t->get_width();
+		if(x+to > Video::get_width())
+			to = Video::get_width()-x;
+		if(from >= to)
+			return;
 		for(py = 0;py < t->get_height();py++)
 		{
-			for(px = 0;px < t->get_width();px++)
-			{
-				Video::set_pixel(x+px,y+py,t->get_pixel(px,py));
-			}
+			if(y+py < 0 || y+py >= Video::get_height())
+				continue;
+			Video::write_span(x+from,y+py,to-from,&t->get_row(py)[from]);
 		}
 	}
 	/* Finds the top vertex */
@@ -195,6 +202,7 @@ namespace Draw
 		v->u = rand()%t->get_width();
 		v->v = rand()%t->get_height();
 		v->color = DRAW_WHITE;
+		v->fog = 0;
 	}
 	/* Look up barycentric coordinates */
 	int draw_y2my3; /* Components of the calculation we only need once per triangle */
@@ -288,25 +296,17 @@ namespace Draw
 	/* Interpolate three colors */
 	int interpolate_color(int c1,int c2,int c3,float af,float bf,float cf)
 	{
-		unsigned char *c1b;
-		unsigned char *c2b;
-		unsigned char *c3b;
-		unsigned char ab,bb,cb;
-		/* Convert alpha to bytes */
-		ab = (unsigned char)(af*255.0f);
-		bb = (unsigned char)(bf*255.0f);
-		cb = (unsigned char)(cf*255.0f);
-		/* Map to bytes */
-		c1b = (unsigned char*)&c1;
-		c2b = (unsigned char*)&c2;
-		c3b = (unsigned char*)&c3;
-		/* Perform */
-		c1b[0] = blend_multiply[c1b[0]][ab]+blend_multiply[c2b[0]][bb]+blend_multiply[c3b[0]][cb];
-		c1b[1] = blend_multiply[c1b[1]][ab]+blend_multiply[c2b[1]][bb]+blend_multiply[c3b[1]][cb];
-		c1b[2] = blend_multiply[c1b[2]][ab]+blend_multiply[c2b[2]][bb]+blend_multiply[c3b[2]][cb];
-		c1b[3] = blend_multiply[c1b[3]][ab]+blend_multiply[c2b[3]][bb]+blend_multiply[c3b[3]][cb];
-		/* Result is in c1 */
-		return c1;
+		int ab,bb,cb;
+		/* Convert weights to bytes, the last one takes the remainder so they always add up to 255 */
+		ab = (int)(af*255.0f+0.5f);
+		bb = (int)(bf*255.0f+0.5f);
+		if(ab < 0) ab = 0;
+		if(ab > 255) ab = 255;
+		if(bb < 0) bb = 0;
+		if(bb > 255-ab) bb = 255-ab;
+		cb = 255-ab-bb;
+		/* Weighted sum of all channels at once */
+		return gather(spread(c1)*ab+spread(c2)*bb+spread(c3)*cb);
 	}
 	/* Interpolate these values */
 	int interpolate(int x1,int x2,int x3,float af,float bf,float cf)
@@ -321,32 +321,371 @@ namespace Draw
 	/* Multiplies two colors */
 	int multiply_color(int c1,int c2)
 	{
-		unsigned char *c1b;
-		unsigned char *c2b;
-		/* Map to bytes */
-		c1b = (unsigned char*)&c1;
-		c2b = (unsigned char*)&c2;
-		/* Apply LUT */
-		c1b[0] = blend_multiply[c1b[0]][c2b[0]];
-		c1b[1] = blend_multiply[c1b[1]][c2b[1]];
-		c1b[2] = blend_multiply[c1b[2]][c2b[2]];
-		c1b[3] = blend_multiply[c1b[3]][c2b[3]];
-		/* c1 is modified with the result */
-		return c1;
+		__m128i a,b,t;
+		/* Widen channels to 16 bits */
+		a = _mm_unpacklo_epi8(_mm_cvtsi32_si128(c1),_mm_setzero_si128());
+		b = _mm_unpacklo_epi8(_mm_cvtsi32_si128(c2),_mm_setzero_si128());
+		/* Multiply and divide by 255 with rounding */
+		t = _mm_add_epi16(_mm_mullo_epi16(a,b),_mm_set1_epi16(128));
+		t = _mm_srli_epi16(_mm_add_epi16(t,_mm_srli_epi16(t,8)),8);
+		return _mm_cvtsi128_si32(_mm_packus_epi16(t,t));
 	}
 	/* Blend pixel */
 	int blend(int x,int y,int c,int s)
 	{
-		unsigned char *cb;
-		unsigned char *sb;
-		/* Map to bytes */
-		cb = (unsigned char*)&c;
-		sb = (unsigned char*)&s;
-		sb[0] = blend_multiply[cb[0]][cb[3]]+blend_multiply_inv[sb[0]][cb[3]];
-		sb[1] = blend_multiply[cb[1]][cb[3]]+blend_multiply_inv[sb[1]][cb[3]];
-		sb[2] = blend_multiply[cb[2]][cb[3]]+blend_multiply_inv[sb[2]][cb[3]];
-		/* s has been modified with the result */
-		return s;
+		unsigned int a;
+		/* Mix both colors by source alpha in one go, destination alpha is kept */
+		a = ((unsigned int)c)>>24;
+		return (gather(spread(c)*a+spread(s)*(255-a))&0x00FFFFFF)|(s&0xFF000000);
+	}
+	/* Blend pixel with operation */
+	int blend_with(int c,int s,int op)
+	{
+		__m128i cv,sv;
+		/* Alpha mixing */
+		if(!op)
+			return blend(0,0,c,s);
+		/* Fully transparent colors are skipped, the rest ignore alpha and keep destination alpha */
+		if(!(c&0xFF000000))
+			return s;
+		c &= 0x00FFFFFF;
+		if(op == DRAW_ADD_QUARTER)
+			c = (c>>2)&0x003F3F3F;
+		cv = _mm_cvtsi32_si128(c);
+		sv = _mm_cvtsi32_si128(s);
+		if(op == DRAW_SUBTRACT)
+			return _mm_cvtsi128_si32(_mm_subs_epu8(sv,cv));
+		return _mm_cvtsi128_si32(_mm_adds_epu8(sv,cv));
+	}
+	/* Blend run of pixels */
+	void fill_blend(int *data,int n,int c,int op)
+	{
+		__m128i cv,av,keep,zero,round,s,lo,hi;
+		int a,i;
+		i = 0;
+		zero = _mm_setzero_si128();
+		keep = _mm_set1_epi32(0xFF000000);
+		if(!op)
+		{
+			/* Alpha mixing, c*a+128 is the same for every pixel so only the scene is multiplied */
+			a = ((unsigned int)c)>>24;
+			av = _mm_set1_epi16(255-a);
+			cv = _mm_unpacklo_epi8(_mm_set1_epi32(c),zero);
+			round = _mm_add_epi16(_mm_mullo_epi16(cv,_mm_set1_epi16(a)),_mm_set1_epi16(128));
+			for(;i+4 <= n;i += 4)
+			{
+				s = _mm_loadu_si128((__m128i*)&data[i]);
+				lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(s,zero),av),round);
+				hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(s,zero),av),round);
+				lo = _mm_srli_epi16(_mm_add_epi16(lo,_mm_srli_epi16(lo,8)),8);
+				hi = _mm_srli_epi16(_mm_add_epi16(hi,_mm_srli_epi16(hi,8)),8);
+				lo = _mm_packus_epi16(lo,hi);
+				_mm_storeu_si128((__m128i*)&data[i],_mm_or_si128(_mm_and_si128(s,keep),_mm_andnot_si128(keep,lo)));
+			}
+		}
+		else if(c&0xFF000000)
+		{
+			/* Saturating operations */
+			c &= 0x00FFFFFF;
+			if(op == DRAW_ADD_QUARTER)
+				c = (c>>2)&0x003F3F3F;
+			cv = _mm_set1_epi32(c);
+			if(op == DRAW_SUBTRACT)
+			{
+				for(;i+4 <= n;i += 4)
+					_mm_storeu_si128((__m128i*)&data[i],_mm_subs_epu8(_mm_loadu_si128((__m128i*)&data[i]),cv));
+			}
+			else
+			{
+				for(;i+4 <= n;i += 4)
+					_mm_storeu_si128((__m128i*)&data[i],_mm_adds_epu8(_mm_loadu_si128((__m128i*)&data[i]),cv));
+			}
+			/* c was already reduced, finish the tail the same way */
+			c |= 0xFF000000;
+			if(op == DRAW_ADD_QUARTER)
+				op = DRAW_ADD;
+		}
+		else
+			return;
+		/* Leftover pixels */
+		for(;i < n;i++)
+			data[i] = blend_with(c,data[i],op);
+	}
+	/* Draw a textured rectangle */
+	void sprite(int x,int y,int w,int h,Texture *t,int u,int v,int tw,int th,int c,int mode)
+	{
+		int x1,y1,x2,y2,n,*data;
+		fint uu,vv,du,dv;
+		if(w <= 0 || h <= 0)
+			return;
+		/* Texture steps are the same for every pixel */
+		du = FINT_FROM_INT(tw)/w;
+		dv = FINT_FROM_INT(th)/h;
+		/* Clip, starting the texture further in */
+		x1 = (x < 0) ? 0 : x;
+		y1 = (y < 0) ? 0 : y;
+		x2 = x+w;
+		y2 = y+h;
+		if(x2 > Video::get_width()) x2 = Video::get_width();
+		if(y2 > Video::get_height()) y2 = Video::get_height();
+		n = x2-x1;
+		if(n <= 0 || y1 >= y2)
+			return;
+		uu = FINT_FROM_INT(u)+du*(x1-x);
+		vv = FINT_FROM_INT(v)+dv*(y1-y);
+		Video::mark_dirty(x1,y1,n,y2-y1);
+		/* Row by row through the span kernel */
+		for(;y1 < y2;y1++)
+		{
+			data = Video::get_span(x1,y1,n);
+			span(data,n,t,uu,vv,du,0,c,mode);
+			Video::put_span();
+			vv += dv;
+			pixels_filled += n;
+		}
+	}
+	/* Draw a rectangle */
+	void rect(int x,int y,int w,int h,int c,int mode)
+	{
+		/* Textured modes just use the color */
+		mode &= ~DRAW_TEXTURE;
+		if(!(mode&7))
+			mode |= DRAW_GOURAD;
+		sprite(x,y,w,h,0,0,0,0,0,c,mode);
+	}
+	/* Finds which sides of a box a point is past */
+	int outcode(long long x,long long y,long long l,long long t,long long r,long long b)
+	{
+		int o;
+		o = 0;
+		if(x < l) o |= 1;
+		if(x > r) o |= 2;
+		if(y < t) o |= 4;
+		if(y > b) o |= 8;
+		return o;
+	}
+	/* Clips a step range so steps land between lo and hi, minor axis steps are round(i*m/n) */
+	int clip_steps(long long p,int s,long long lo,long long hi,long long *first,long long *last)
+	{
+		/* Steps from p in direction s that stay inside */
+		if(s < 0)
+		{
+			long long t;
+			t = lo;
+			lo = -hi;
+			hi = -t;
+			p = -p;
+		}
+		lo -= p;
+		hi -= p;
+		if(lo > *first) *first = lo;
+		if(hi < *last) *last = hi;
+		return *first <= *last;
+	}
+	/* Draw a line */
+	void line(int x1,int y1,int x2,int y2,int c,int mode)
+	{
+		long long ax,ay,bx,by,x,y,dx,dy,n,m,i,last,qlo,qhi,rem;
+		int o,oa,ob,sx,sy,px,py,w,h,blend,op,xmajor;
+		w = Video::get_width();
+		h = Video::get_height();
+		/* Lines reaching far off screen are first cut down to a guard band (Cohen-Sutherland),
+		so the step math below can not overflow */
+		ax = x1; ay = y1;
+		bx = x2; by = y2;
+		oa = outcode(ax,ay,-DRAW_LINE_GUARD,-DRAW_LINE_GUARD,w+DRAW_LINE_GUARD,h+DRAW_LINE_GUARD);
+		ob = outcode(bx,by,-DRAW_LINE_GUARD,-DRAW_LINE_GUARD,w+DRAW_LINE_GUARD,h+DRAW_LINE_GUARD);
+		while(oa|ob)
+		{
+			if(oa&ob)
+				return;
+			o = oa ? oa : ob;
+			if(o&1)      { x = -DRAW_LINE_GUARD;  y = ay+(by-ay)*(x-ax)/(bx-ax); }
+			else if(o&2) { x = w+DRAW_LINE_GUARD; y = ay+(by-ay)*(x-ax)/(bx-ax); }
+			else if(o&4) { y = -DRAW_LINE_GUARD;  x = ax+(bx-ax)*(y-ay)/(by-ay); }
+			else         { y = h+DRAW_LINE_GUARD; x = ax+(bx-ax)*(y-ay)/(by-ay); }
+			if(o == oa) { ax = x; ay = y; oa = outcode(ax,ay,-DRAW_LINE_GUARD,-DRAW_LINE_GUARD,w+DRAW_LINE_GUARD,h+DRAW_LINE_GUARD); }
+			else        { bx = x; by = y; ob = outcode(bx,by,-DRAW_LINE_GUARD,-DRAW_LINE_GUARD,w+DRAW_LINE_GUARD,h+DRAW_LINE_GUARD); }
+		}
+		/* Step along the major axis, minor axis steps are round(i*m/n) */
+		dx = bx-ax;
+		dy = by-ay;
+		sx = (dx < 0) ? -1 : 1;
+		sy = (dy < 0) ? -1 : 1;
+		dx *= sx;
+		dy *= sy;
+		xmajor = dx >= dy;
+		n = xmajor ? dx : dy;
+		m = xmajor ? dy : dx;
+		/* Clip exactly in steps, so a line keeps its pixels as it crosses the edge of the screen */
+		i = 0;
+		last = n;
+		qlo = 0;
+		qhi = m;
+		if(!clip_steps(xmajor ? ax : ay,xmajor ? sx : sy,0,(xmajor ? w : h)-1,&i,&last))
+			return;
+		if(!clip_steps(xmajor ? ay : ax,xmajor ? sy : sx,0,(xmajor ? h : w)-1,&qlo,&qhi))
+			return;
+		if(m)
+		{
+			/* First step with round(i*m/n) >= qlo and last with round(i*m/n) <= qhi */
+			if(qlo > 0)
+			{
+				x = (2*n*qlo-n+2*m-1)/(2*m);
+				if(x > i) i = x;
+			}
+			x = (2*n*(qhi+1)-n-1)/(2*m);
+			if(x < last) last = x;
+			if(i > last)
+				return;
+			x = (2*i*m+n)/(2*n);
+			rem = (2*i*m+n)%(2*n);
+		}
+		else
+		{
+			x = 0;
+			rem = n;
+		}
+		px = (int)((xmajor ? ax+i*sx : ax+x*sx));
+		py = (int)((xmajor ? ay+x*sy : ay+i*sy));
+		/* Mark the box between the first and last pixel */
+		x = (2*last*m+n)/(2*(n ? n : 1));
+		bx = xmajor ? ax+last*sx : ax+x*sx;
+		by = xmajor ? ay+x*sy : ay+last*sy;
+		Video::mark_dirty(px < bx ? px : (int)bx,py < by ? py : (int)by,(int)llabs(bx-px)+1,(int)llabs(by-py)+1);
+		blend = mode&DRAW_BLEND;
+		op = mode&DRAW_BLEND_OPS;
+		for(;i <= last;i++)
+		{
+			if(blend)
+				Video::set_pixel(px,py,blend_with(c,Video::get_pixel(px,py),op));
+			else
+				Video::set_pixel(px,py,c);
+			pixels_filled++;
+			rem += 2*m;
+			if(xmajor)
+				px += sx;
+			else
+				py += sy;
+			if(rem >= 2*n)
+			{
+				rem -= 2*n;
+				if(xmajor)
+					py += sy;
+				else
+					px += sx;
+			}
+		}
+	}
+	/* Draw a point */
+	void point(int x,int y,int r,int c,int mode)
+	{
+		rect(x-r,y-r,r*2+1,r*2+1,c,mode);
+	}
+	/* Set fog color */
+	void fog_color(int c)
+	{
+		draw_fog = spread((unsigned int)c);
+	}
+	/* Fade toward fog */
+	int fog(int c,int f)
+	{
+		return (int)((gather(spread((unsigned int)c)*(255-f)+draw_fog*f)&0x00FFFFFF)|((unsigned int)c&0xFF000000));
+	}
+	/* Copy keyed pixels */
+	void copy_keyed(int *d,int *s,int n)
+	{
+		__m128i p,keep,zero,alpha;
+		int i;
+		/* Keep the destination wherever the source has no alpha, four at a time */
+		zero = _mm_setzero_si128();
+		alpha = _mm_set1_epi32(0xFF000000);
+		for(i = 0;i+4 <= n;i += 4)
+		{
+			p = _mm_loadu_si128((__m128i*)&s[i]);
+			keep = _mm_cmpeq_epi32(_mm_and_si128(p,alpha),zero);
+			_mm_storeu_si128((__m128i*)&d[i],_mm_or_si128(_mm_andnot_si128(keep,p),_mm_and_si128(keep,_mm_loadu_si128((__m128i*)&d[i]))));
+		}
+		for(;i < n;i++)
+		{
+			if(s[i]&0xFF000000)
+				d[i] = s[i];
+		}
+	}
+	/* Draws a run of pixels in one color */
+	void span(int *data,int n,Texture *tex,fint uu,fint vv,fint du,fint dv,int color,int mode)
+	{
+		int samples[DRAW_SPAN_CHUNK],*row;
+		int x,i,k,u,mask,op;
+		op = mode&DRAW_BLEND_OPS;
+		mode &= 7;
+		if(n <= 0)
+			return;
+		/* Untextured */
+		if(mode == DRAW_GOURAD)
+		{
+			for(x = 0;x < n;x++)
+				data[x] = color;
+			return;
+		}
+		if(mode == DRAW_BLEND || mode == (DRAW_GOURAD|DRAW_BLEND))
+		{
+			fill_blend(data,n,color,op);
+			return;
+		}
+		/* Unscaled texture rows are copied straight */
+		u = FINT_TO_INT(uu);
+		if(!mode && du == FINT_ONE && !dv && u >= 0 && u+n <= tex->get_width())
+		{
+			copy_keyed(data,&tex->get_row(FINT_TO_INT(vv))[u],n);
+			return;
+		}
+		/* Fetch texels a chunk at a time (from one row when v does not change), then shade them */
+		row = dv ? 0 : tex->get_row(FINT_TO_INT(vv));
+		mask = tex->get_width()-1;
+		for(x = 0;x < n;x += k)
+		{
+			k = n-x;
+			if(k > DRAW_SPAN_CHUNK)
+				k = DRAW_SPAN_CHUNK;
+			if(row)
+			{
+				for(i = 0;i < k;i++)
+				{
+					samples[i] = row[FINT_TO_INT(uu)&mask];
+					uu += du;
+				}
+			}
+			else
+			{
+				for(i = 0;i < k;i++)
+				{
+					samples[i] = tex->get_pixel(FINT_TO_INT(uu),FINT_TO_INT(vv));
+					uu += du;
+					vv += dv;
+				}
+			}
+			switch(mode)
+			{
+			case 7:
+			case 6:
+				for(i = 0;i < k;i++) /* TEXTURE BLEND */
+					data[i] = blend_with(multiply_color(color,samples[i]),data[i],op);
+				break;
+			case 5:
+			case 4:
+				for(i = 0;i < k;i++) /* TEXTURE */
+				{
+					if(samples[i]&0xFF000000)
+						data[i] = multiply_color(color,samples[i]);
+				}
+				break;
+			case 0:
+				copy_keyed(data,samples,k); /* RAW TEXTURE */
+				break;
+			}
+			data += k;
+		}
 	}
 	/* Draws a slice of triangle */
 	fint draw_a1,draw_b1,draw_c1; /* Barycentric coordinate (from) */
@@ -360,8 +699,13 @@ namespace Draw
 		fint dred,dgreen,dblue,dextra;
 		fint red,green,blue,extra;
 		fint du,dv,uu,vv;
-		int u,v,s;
+		fint ff,df;
+		int u,v,s,op,fogged;
 		unsigned char *colorb;
+		/* Separate blend operation and fog from the shading mode */
+		op = mode&DRAW_BLEND_OPS;
+		fogged = mode&DRAW_FOG;
+		mode &= 7;
 		/* Find the run length of the slice */
 		run = FINT_FROM_INT(to-from);
 		if(run <= 0)
@@ -418,6 +762,54 @@ namespace Draw
 			du = FINT_DIV(du,run);
 			dv = FINT_DIV(dv,run);
 		}
+		/* Fogged spans share one loop */
+		if(fogged)
+		{
+			ff = FINT_MUL(FINT_FROM_INT(a->fog),draw_a1)+FINT_MUL(FINT_FROM_INT(b->fog),draw_b1)+FINT_MUL(FINT_FROM_INT(c->fog),draw_c1);
+			df = FINT_MUL(FINT_FROM_INT(a->fog),draw_a2)+FINT_MUL(FINT_FROM_INT(b->fog),draw_b2)+FINT_MUL(FINT_FROM_INT(c->fog),draw_c2);
+			df = FINT_DIV(FINT_SUB(df,ff),run);
+			for(x = from;x < to;x++) /* FOG */
+			{
+				/* Find interpolated color */
+				if(mode&DRAW_GOURAD)
+				{
+					if(red > FINT_MASK)   colorb[0] = 0xFF; else colorb[0] = FINT_TO_COLOR(red);
+					if(green > FINT_MASK) colorb[1] = 0xFF; else colorb[1] = FINT_TO_COLOR(green);
+					if(blue > FINT_MASK)  colorb[2] = 0xFF; else colorb[2] = FINT_TO_COLOR(blue);
+					if(extra > FINT_MASK) colorb[3] = 0xFF; else colorb[3] = FINT_TO_COLOR(extra);
+					red += dred;
+					green += dgreen;
+					blue += dblue;
+					extra += dextra;
+				}
+				sample = color;
+				/* Find texture coordinate and sample */
+				if(!mode || (mode&DRAW_TEXTURE))
+				{
+					u = FINT_TO_INT(uu);
+					v = FINT_TO_INT(vv);
+					sample = tex->get_pixel(u,v);
+					uu += du;
+					vv += dv;
+					if(mode)
+						sample = multiply_color(color,sample);
+				}
+				/* Fade */
+				s = FINT_TO_INT(ff);
+				if(s < 0) s = 0;
+				if(s > 255) s = 255;
+				ff += df;
+				/* Set or blend color */
+				if(mode&DRAW_BLEND)
+					data[0] = blend_with(fog(sample,s),data[0],op);
+				else if((mode == DRAW_GOURAD) || (sample&0xFF000000))
+					data[0] = fog(sample,s);
+				/* Advance */
+				data++;
+			}
+			pixels_filled += (to-from);
+			return;
+		}
 		/* Choose drawing method */
 		switch(mode)
 		{
@@ -440,24 +832,7 @@ namespace Draw
 				/* Mix color */
 				color = multiply_color(color,sample);
 				s = data[0];
-				data[0] = blend(x,y,color,s);
-				/* Advance */
-				uu += du;
-				vv += dv;
-				data++;
-			}
-			break;
-		case 6:
-			for(x = from;x < to;x++) /* TEXTURE BLEND */
-			{
-				/* Find texture coordinate and sample */
-				u = FINT_TO_INT(uu);
-				v = FINT_TO_INT(vv);
-				sample = tex->get_pixel(u,v);
-				/* Mix color */
-				sample = multiply_color(color,sample);
-				s = data[0];
-				data[0] = blend(x,y,sample,s);
+				data[0] = blend_with(color,s,op);
 				/* Advance */
 				uu += du;
 				vv += dv;
@@ -489,22 +864,6 @@ namespace Draw
 				data++;
 			}
 			break;
-		case 4:
-			for(x = from;x < to;x++) /* TEXTURE */
-			{
-				/* Find texture coordinate and sample */
-				u = FINT_TO_INT(uu);
-				v = FINT_TO_INT(vv);
-				sample = tex->get_pixel(u,v);
-				/* Set color */
-				if(sample&0xFF000000)
-					data[0] = multiply_color(color,sample);
-				/* Advance */
-				uu += du;
-				vv += dv;
-				data++;
-			}
-			break;
 		case 3:
 			for(x = from;x < to;x++) /* GOURAD BLEND */
 			{
@@ -519,7 +878,7 @@ namespace Draw
 				extra += dextra;
 				/* Directly blend with current color */
 				s = data[0];
-				data[0] = blend(x,y,color,s);
+				data[0] = blend_with(color,s,op);
 				/* Advance */
 				data++;
 			}
@@ -542,21 +901,8 @@ namespace Draw
 				data++;
 			}
 			break;
-		case 0:
-			for(x = from;x < to;x++) /* RAW TEXTURE */
-			{
-				/* Find texture coordinate and sample */
-				u = FINT_TO_INT(uu);
-				v = FINT_TO_INT(vv);
-				sample = tex->get_pixel(u,v);
-				/* Set color */
-				if(sample&0xFF000000)
-					data[0] = sample;
-				/* Advance */
-				uu += du;
-				vv += dv;
-				data++;
-			}
+		default:
+			span(data,to-from,tex,uu,vv,du,dv,color,mode|op); /* RAW TEXTURE, BLEND, TEXTURE, TEXTURE BLEND */
 			break;
 		}
 		/* Count pixels filled */
@@ -604,8 +950,9 @@ namespace Draw
 				barycentric_fast(side,xfrom,y,&draw_a1,&draw_b1,&draw_c1);
 				barycentric_fast(side,xto,y,&draw_a2,&draw_b2,&draw_c2);
 				/* Draw slice */
-				data = Video::get_data(xfrom,y);
+				data = Video::get_span(xfrom,y,xto-xfrom);
 				slice(top,bottom,side,t,xfrom,xto,y,data,mode);
+				Video::put_span();
 				/* Adjust */
 				xlong += dlong;
 				xside += dside;
@@ -623,15 +970,21 @@ namespace Draw
 		int dx1,dx2,dx3; /* Differences in x */
 		float d1,d2,d3; /* Step sizes for x */
 		float xcont; /* Where the x coordinate on the long side is to be resumed at */
-		/* Invalid mode */
-		if(mode == 2)
-			return;
+		int xmin,xmax; /* Horizontal extent */
 		/* Find top and bottom */
 		top = find_top(a,b,c);
 		bottom = find_bottom(a,b,c);
 		/* If these are the same, then the triangle is a degenerate and can be discarded from rendering */
 		if(top == bottom)
 			return;
+		/* Report the area covered */
+		xmin = a->x;
+		xmax = a->x;
+		if(b->x < xmin) xmin = b->x;
+		if(b->x > xmax) xmax = b->x;
+		if(c->x < xmin) xmin = c->x;
+		if(c->x > xmax) xmax = c->x;
+		Video::mark_dirty(xmin,top->y,xmax-xmin+1,bottom->y-top->y+1);
 		/* Find side */
 		side = a;
 		if(side == top || side == bottom)
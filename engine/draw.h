@@ -22,6 +22,21 @@
 #define DRAW_BLEND 2
 #define DRAW_TEXTURE 4
 
+/* Blend operations (only used along with DRAW_BLEND) */
+#define DRAW_ADD 8 /* Adds the color to the scene (B+F) */
+#define DRAW_SUBTRACT 16 /* Subtracts the color from the scene (B-F) */
+#define DRAW_ADD_QUARTER 24 /* Adds a quarter of the color to the scene (B+F/4) */
+#define DRAW_BLEND_OPS 24 /* Mask of blend operation bits */
+
+/* Texels fetched at a time by the span kernel */
+#define DRAW_SPAN_CHUNK 64
+
+/* Pixels past the screen a line may reach before it is cut short (longer lines may shift by a pixel) */
+#define DRAW_LINE_GUARD 16384
+
+/* Fog (added to any mode) */
+#define DRAW_FOG 32 /* Fades every pixel toward the fog color by the vertex fog amounts */
+
 /* REMARKS: */
 /*
 	DRAW_RAW (Mode 0) is the fastest and probably most common mode,
@@ -35,6 +50,20 @@
 
 	DRAW_GOURAD (Mode 1) is good for drawing untextured triangles.
 	It is also the second fastest mode which is great since you still get realtime shading.
+
+	DRAW_BLEND (Mode 2) alone fills the triangle with its first vertex color blended against the scene,
+	several pixels at a time, which makes it the cheap way to do flat translucent effects.
+
+	Blended modes mix by the color's alpha unless a blend operation is added to the mode.
+	The operations match PSX semi-transparency, they ignore alpha (except that fully transparent
+	colors and texels are skipped) and saturate instead of wrapping.
+
+	Screen aligned rectangles have their own primitives, rect and sprite, which skip triangle setup
+	and step texture coordinates by constant amounts through the same span kernel as triangles.
+
+	DRAW_FOG interpolates the fog amount of the vertices and fades each pixel toward the fog color
+	just before it is written (or blended), keeping its alpha. Fogged spans go through one loop shared
+	by every mode, so untextured Gouraud triangles are better fogged by fading their vertex colors instead.
 */
 /* Mode 0: ~4840 ~22552 */
 /* Mode 1: ~6829 ~8064  */
@@ -82,6 +111,11 @@ public:
 		x,y - coordinate of pixel to get
 	*/
 	int get_pixel(int x,int y);
+	/*
+		Gets a row of pixels for reading in sequence (width pixels long)
+		y - the row (wraps like get_pixel)
+	*/
+	int *get_row(int y);
 	/*
 		Sets a pixel on texture
 		Setting a pixel out of bounds does nothing
@@ -89,6 +123,11 @@ public:
 		c - pixel
 	*/
 	void set_pixel(int x,int y,int c);
+	/*
+		Replaces every pixel of the texture at once
+		p - width*height pixels, row by row
+	*/
+	void set_data(int *p);
 	/*
 		Fills the texture with a test pattern
 	*/
@@ -112,6 +151,7 @@ typedef struct
 	int u; /* Texture coordinate */
 	int v;
 	int color; /* Vertex color */
+	int fog; /* Fog amount (0 to 255, only used with DRAW_FOG) */
 }Vertex2D;
 
 /* Draw */
@@ -167,9 +207,104 @@ namespace Draw
 	*/
 	extern void reset_pixels_filled();
 	/*
-		Populates blending LUT tables
+		Mixes three colors by barycentric weights
+		c1,c2,c3 - the colors
+		af,bf,cf - weight of each color (adding up to 1)
+	*/
+	extern int interpolate_color(int c1,int c2,int c3,float af,float bf,float cf);
+	/*
+		Multiplies two colors channel by channel (255 being one)
+		c1,c2 - the colors
+	*/
+	extern int multiply_color(int c1,int c2);
+	/*
+		Blends a color over a pixel by the color's alpha, the pixel's alpha is kept
+		x,y - location of pixel
+		c - color to blend
+		s - the pixel
+	*/
+	extern int blend(int x,int y,int c,int s);
+	/*
+		Blends a color over a pixel with the given blend operation
+		c - color to blend
+		s - the pixel
+		op - blend operation bits of the mode (0 for alpha blending)
+	*/
+	extern int blend_with(int c,int s,int op);
+	/*
+		Blends one color over a run of pixels with the given blend operation
+		data - first pixel
+		n - count of pixels
+		c - color to blend
+		op - blend operation bits of the mode (0 for alpha blending)
+	*/
+	extern void fill_blend(int *data,int n,int c,int op);
+	/*
+		Copies a run of pixels, skipping those with zero alpha (four at a time with SSE)
+		d - destination
+		s - source
+		n - count of pixels
+	*/
+	extern void copy_keyed(int *d,int *s,int n);
+	/*
+		Draws a run of pixels in one color, stepping texture coordinates by constant amounts
+		Gourad modes have nothing to interpolate, so they draw like the flat ones
+		data - first pixel
+		n - count of pixels
+		tex - the texture (only for textured modes)
+		uu,vv - texture coordinate of the first pixel
+		du,dv - texture coordinate steps per pixel
+		color - the color
+		mode - render mode
+	*/
+	extern void span(int *data,int n,Texture *tex,fint uu,fint vv,fint du,fint dv,int color,int mode);
+	/*
+		Draws a textured rectangle, clipped to the screen
+		The texture is stretched over it and wraps like on triangles
+		x,y - top left
+		w,h - size
+		t - the texture
+		u,v - texture coordinate of the top left
+		tw,th - size of the texture area
+		c - the color
+		mode - render mode (Gourad modes draw like the flat ones)
+	*/
+	extern void sprite(int x,int y,int w,int h,Texture *t,int u,int v,int tw,int th,int c,int mode);
+	/*
+		Draws a rectangle, clipped to the screen
+		x,y - top left
+		w,h - size
+		c - the color
+		mode - render mode (textured modes just use the color)
+	*/
+	extern void rect(int x,int y,int w,int h,int c,int mode);
+	/*
+		Draws a line, clipped to the screen
+		Clipping keeps the pixels of the whole line, so it does not wobble as it leaves the screen
+		x1,y1,x2,y2 - end points (both are drawn)
+		c - the color
+		mode - render mode (like rect)
+	*/
+	extern void line(int x1,int y1,int x2,int y2,int c,int mode);
+	/*
+		Draws a square point sprite, clipped to the screen
+		x,y - center
+		r - half of the size (0 for a single pixel)
+		c - the color
+		mode - render mode (like rect)
+	*/
+	extern void point(int x,int y,int r,int c,int mode);
+	/*
+		Sets the color DRAW_FOG fades toward
+		c - the fog color
+	*/
+	extern void fog_color(int c);
+	/*
+		Fades a color toward the fog color, keeping its alpha
+		c - the color
+		f - fog amount (0 to 255)
 	*/
-	extern void calculate_multiply();
+	extern int fog(int c,int f);
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,252 @@
+/*
+	Font - Bitmap font text
+*/
+
+/* Includes */
+#include <string.h>
+#include "font.h"
+
+/* New font */
+Font :: Font(Texture *t,int w,int h)
+{
+	int i,across,x,y,width,*row;
+	page = t;
+	line_height = h;
+	clock = 0;
+	hits = 0;
+	misses = 0;
+	memset(cache,0,sizeof(cache));
+	across = (w > 0) ? t->get_width()/w : 0;
+	for(i = 0;i < FONT_GLYPHS;i++)
+	{
+		glyphs[i].w = 0;
+		glyphs[i].h = h;
+		glyphs[i].advance = 0;
+		glyphs[i].sx = 0;
+		glyphs[i].sy = 0;
+		if(!across || (i/across+1)*h > t->get_height())
+			continue;
+		glyphs[i].sx = (i%across)*w;
+		glyphs[i].sy = (i/across)*h;
+		/* Width reaches the rightmost column with any alpha */
+		width = 0;
+		for(y = 0;y < h;y++)
+		{
+			row = &t->get_row(glyphs[i].sy+y)[glyphs[i].sx];
+			for(x = w-1;x >= width;x--)
+			{
+				if(row[x]&0xFF000000)
+				{
+					width = x+1;
+					break;
+				}
+			}
+		}
+		glyphs[i].w = width;
+		glyphs[i].advance = width+1;
+	}
+	/* Blank space would measure as nothing */
+	glyphs[0].advance = w/2;
+}
+
+/* Delete font */
+Font :: ~Font()
+{
+	flush();
+}
+
+/* Get glyph */
+FontGlyph *Font :: get_glyph(int c)
+{
+	c = (unsigned char)c;
+	if(c < FONT_FIRST || c >= FONT_FIRST+FONT_GLYPHS)
+		return 0;
+	return &glyphs[c-FONT_FIRST];
+}
+
+/* Set glyph */
+void Font :: set_glyph(int c,int sx,int sy,int w,int h,int advance)
+{
+	FontGlyph *g;
+	g = get_glyph(c);
+	if(!g)
+		return;
+	g->sx = sx;
+	g->sy = sy;
+	g->w = w;
+	g->h = h;
+	g->advance = advance;
+	/* Cached layouts used the old metrics */
+	flush();
+}
+
+/* Measure word */
+int Font :: word_width(const char *s)
+{
+	FontGlyph *g;
+	int w;
+	w = 0;
+	for(;*s && *s != ' ' && *s != '\n';s++)
+	{
+		g = get_glyph(*s);
+		if(g)
+			w += g->advance;
+	}
+	return w;
+}
+
+/* Lay out text */
+int Font :: layout(int x,int y,const char *s,int wrap,SpriteBlit *out)
+{
+	FontGlyph *g;
+	SpriteBlit *b;
+	int px,py,n;
+	px = 0;
+	py = 0;
+	n = 0;
+	for(;*s;s++)
+	{
+		if(*s == '\n')
+		{
+			px = 0;
+			py += line_height;
+			continue;
+		}
+		/* Wrap before a word that does not fit */
+		if(wrap > 0 && px > 0 && *s != ' ' && (s[-1] == ' ') && px+word_width(s) > wrap)
+		{
+			px = 0;
+			py += line_height;
+		}
+		g = get_glyph(*s);
+		if(!g)
+			continue;
+		/* Spaces only move the pen */
+		if(g->w > 0 && *s != ' ')
+		{
+			b = &out[n++];
+			b->x = x+px;
+			b->y = y+py;
+			b->sx = g->sx;
+			b->sy = g->sy;
+			b->w = g->w;
+			b->h = g->h;
+			b->flags = SPRITE_KEYED;
+		}
+		px += g->advance;
+	}
+	return n;
+}
+
+/* Measure text */
+void Font :: measure(const char *s,int wrap,int *w,int *h)
+{
+	FontGlyph *g;
+	int px;
+	w[0] = 0;
+	h[0] = *s ? line_height : 0;
+	px = 0;
+	for(;*s;s++)
+	{
+		if(*s == '\n')
+		{
+			px = 0;
+			h[0] += line_height;
+			continue;
+		}
+		if(wrap > 0 && px > 0 && *s != ' ' && (s[-1] == ' ') && px+word_width(s) > wrap)
+		{
+			px = 0;
+			h[0] += line_height;
+		}
+		g = get_glyph(*s);
+		if(!g)
+			continue;
+		px += g->advance;
+		if(px > w[0])
+			w[0] = px;
+	}
+}
+
+/* Draw text */
+void Font :: draw_text(int x,int y,const char *s,int wrap)
+{
+	FontLayout *l,*oldest;
+	int i,j,dx,dy,n;
+	clock++;
+	/* Laid out before? */
+	oldest = &cache[0];
+	for(i = 0;i < FONT_CACHE;i++)
+	{
+		l = &cache[i];
+		if(l->text && l->wrap == wrap && !strcmp(l->text,s))
+		{
+			/* Moving only shifts the sprites */
+			if(l->x != x || l->y != y)
+			{
+				dx = x-l->x;
+				dy = y-l->y;
+				for(j = 0;j < l->count;j++)
+				{
+					l->blits[j].x += dx;
+					l->blits[j].y += dy;
+				}
+				l->x = x;
+				l->y = y;
+			}
+			l->used = clock;
+			hits++;
+			Sprite::batch(page,l->count,l->blits);
+			return;
+		}
+		if(!l->text || (oldest->text && l->used < oldest->used))
+			oldest = l;
+	}
+	/* Lay out over the least recently drawn string */
+	misses++;
+	l = oldest;
+	n = strlen(s);
+	delete[] l->text;
+	delete[] l->blits;
+	l->text = new char[n+1];
+	memcpy(l->text,s,n+1);
+	l->blits = new SpriteBlit[n > 0 ? n : 1];
+	l->wrap = wrap;
+	l->x = x;
+	l->y = y;
+	l->count = layout(x,y,s,wrap,l->blits);
+	l->used = clock;
+	Sprite::batch(page,l->count,l->blits);
+}
+
+/* Forget layouts */
+void Font :: flush()
+{
+	int i;
+	for(i = 0;i < FONT_CACHE;i++)
+	{
+		delete[] cache[i].text;
+		delete[] cache[i].blits;
+		cache[i].text = 0;
+		cache[i].blits = 0;
+		cache[i].count = 0;
+	}
+}
+
+/* Get line height */
+int Font :: get_line_height()
+{
+	return line_height;
+}
+
+/* Get cache hits */
+int Font :: get_cache_hits()
+{
+	return hits;
+}
+
+/* Get cache misses */
+int Font :: get_cache_misses()
+{
+	return misses;
+}
\ No newline at end of file
@@ -0,0 +1,117 @@
+#ifndef FONT_H
+#define FONT_H
+
+/* Defines */
+#define FONT_FIRST 32 /* First character in a font page (space) */
+#define FONT_GLYPHS 96 /* Characters in a font page (space to DEL) */
+#define FONT_CACHE 32 /* Laid out strings kept per font */
+
+/* Includes */
+#include "sprite.h"
+
+/* REMARKS: */
+/*
+	A font page is a texture holding the glyphs in a grid of equal cells, in character order
+	from FONT_FIRST, row by row. Glyph widths are measured from the alpha of each cell
+	(the rightmost column with any alpha), so proportional fonts need no metrics file,
+	set_glyph overrides them for fonts that do not fit the grid.
+	Text is laid out into a list of sprites drawn with one Sprite::batch call.
+	Laid out strings are cached by their text and wrap width, so unchanged text costs a lookup,
+	moving it only shifts the sprites. The least recently drawn string makes room for new ones.
+*/
+
+/* Glyph metrics */
+typedef struct
+{
+	int sx; /* Top left in the font page */
+	int sy;
+	int w; /* Size */
+	int h;
+	int advance; /* How far the pen moves after it */
+}FontGlyph;
+
+/* Laid out string */
+typedef struct
+{
+	char *text; /* Copy of the text (0 for an empty entry) */
+	int wrap; /* Wrap width it was laid out for */
+	int x; /* Location it was laid out at */
+	int y;
+	int count; /* Count of sprites */
+	SpriteBlit *blits; /* The sprites */
+	int used; /* When it was last drawn */
+}FontLayout;
+
+/* Font */
+class Font
+{
+private:
+	Texture *page; /* Texture holding the glyphs */
+	FontGlyph glyphs[FONT_GLYPHS]; /* Metrics of each glyph */
+	int line_height; /* Distance between lines */
+	FontLayout cache[FONT_CACHE]; /* Laid out strings */
+	int clock; /* Counts draws, to find the least recently drawn string */
+	int hits; /* Cache statistics */
+	int misses;
+	/*
+		Gets the glyph of a character (0 if it has none)
+		c - the character
+	*/
+	FontGlyph *get_glyph(int c);
+	/*
+		Measures the word starting at a character
+		s - the text
+	*/
+	int word_width(const char *s);
+public:
+	/*
+		Creates a font from a page of glyphs in a grid, measuring each glyph
+		t - the font page
+		w,h - size of a cell (in pixels)
+	*/
+	Font(Texture *t,int w,int h);
+	~Font();
+	/*
+		Overrides the metrics of a glyph
+		c - the character
+		sx,sy - top left in the font page
+		w,h - size
+		advance - how far the pen moves after it
+	*/
+	void set_glyph(int c,int sx,int sy,int w,int h,int advance);
+	/*
+		Lays out text
+		Returns count of sprites written (at most one per character)
+		x,y - top left of the text
+		s - the text (new lines start a new line)
+		wrap - width to wrap words at (0 for none)
+		out - output sprites
+	*/
+	int layout(int x,int y,const char *s,int wrap,SpriteBlit *out);
+	/*
+		Measures text
+		s - the text
+		wrap - width to wrap words at (0 for none)
+		w,h - size of the text (in pixels)
+	*/
+	void measure(const char *s,int wrap,int *w,int *h);
+	/*
+		Draws text, reusing its layout when it was drawn before
+		x,y - top left of the text
+		s - the text
+		wrap - width to wrap words at (0 for none)
+	*/
+	void draw_text(int x,int y,const char *s,int wrap);
+	/*
+		Forgets every cached layout
+	*/
+	void flush();
+	/*
+		Gets font contents
+	*/
+	int get_line_height();
+	int get_cache_hits();
+	int get_cache_misses();
+};
+
+#endif
\ No newline at end of file
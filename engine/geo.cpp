@@ -5,25 +5,54 @@
 /* Includes */
 #include "geo.h"
 #include "video.h"
+#include <math.h>
+#include <memory.h>
+#include <xmmintrin.h>
+#include <emmintrin.h>
 
 /* Geo */
 namespace Geo
 {
+	/* Light */
+	typedef struct
+	{
+		int type; /* Light type */
+		float x,y,z; /* Direction it shines in or position (world space) */
+		float range; /* Distance at which a point light fades out */
+		float r,g,b; /* Color (1 being full) */
+	}GeoLight;
 	/* Globals */
-	Matrix *geo_transform[GEO_MATRIX_STACK]; /* Current transformation matrix stack */
-	Matrix *geo_adjust; /* Adjust transform matrix */
+	Matrix geo_transform[GEO_MATRIX_STACK]; /* Current transformation matrix stack */
+	Matrix geo_adjust; /* Adjust transform matrix */
+	Matrix geo_view; /* Camera view matrix */
+	Matrix geo_projection; /* Camera projection matrix */
+	int geo_projected = 0; /* Is there a projection? */
+	Matrix geo_combined; /* Projection, view and current transform combined */
+	int geo_dirty = 1; /* Combined matrix needs to be rebuilt */
+	float geo_planes[GEO_MAX_PLANES*4]; /* View frustum planes in the space of the current transform */
+	int geo_plane_count = 0;
+	int geo_planes_dirty = 1; /* Frustum needs to be rebuilt from the combined matrix */
+	int geo_culled_objects = 0; /* Culled this frame */
+	int geo_culled_points = 0;
 	int geo_stack = 0; /* Current transform stack pointer */
 	float geo_screen_scale_y = 1.0f; /* Screen scale values (aspect correction) */
 	float geo_screen_scale_x = 0.0f;
 	int geo_active = 0; /* Geo render ready? */
-	Vector *geo_points[GEO_MAX_POINTS]; /* Points to define object to be drawn */
-	Vertex2D geo_vertex[GEO_MAX_POINTS]; /* Vertex matching points */
+	Vertex2D *geo_vertex = 0; /* Vertex matching points (in frame arena while drawing) */
+	float *geo_points = 0; /* Transformed points, 4 floats each (in frame arena while drawing) */
 	Texture *geo_texture; /* Current texture */
 	int geo_mode; /* Current render mode */
+	GeoLight geo_lights[GEO_MAX_LIGHTS]; /* Lights */
+	int geo_light_count = 0;
+	float geo_ambient[3] = {0.25f,0.25f,0.25f}; /* Ambient light */
+	int geo_light_generation = 1; /* Bumped by every light change */
+	int geo_wireframe = 0; /* Draw edges instead of triangles? */
+	int geo_fog = 0; /* Is there fog? */
+	float geo_fog_start = 0.0f; /* View depths of fog start and end */
+	float geo_fog_end = 0.0f;
 	/* Init geo library */
 	void init()
 	{
-		int i;
 		/* Already started? */
 		if(geo_active)
 			return;
@@ -32,13 +61,10 @@ namespace Geo
 		geo_screen_scale_x = ((float)Video::get_height());
 		geo_screen_scale_x /= ((float)Video::get_width());
 		/* Transform matrix */
-		for(i = 0;i < GEO_MATRIX_STACK;i++)
-			geo_transform[i] = new Matrix();
-		geo_adjust = new Matrix();
 		geo_stack = 0;
-		/* Points */
-		for(i = 0;i < GEO_MAX_POINTS;i++)
-			geo_points[i] = new Vector(0.0f,0.0f,0.0f,0.0f);
+		geo_transform[0].identity();
+		/* Camera */
+		reset_camera();
 		/* Texture */
 		geo_texture = 0;
 		/* Mode */
@@ -49,36 +75,29 @@ namespace Geo
 	/* Exit geo library */
 	void exit()
 	{
-		int i;
 		/* Already stopped? */
 		if(!geo_active)
 			return;
-		/* Points */
-		for(i = 0;i < GEO_MAX_POINTS;i++)
-			delete geo_points[i];
-		/* Transform matrix */
-		for(i = 0;i < GEO_MATRIX_STACK;i++)
-			delete geo_transform[i];
-		delete geo_adjust;
 		/* Done */
 		geo_active = 0;
 	}
 	/* Sets current transform to identity */
 	void identity()
 	{
-		geo_transform[geo_stack]->identity();
+		geo_transform[geo_stack].identity();
+		geo_dirty = 1;
 	}
 	/* Raises the transformation stack by 1 */
 	void push()
 	{
 		Matrix *m;
 		/* Max stack? */
-		if(geo_stack >= GEO_MATRIX_STACK)
+		if(geo_stack >= GEO_MATRIX_STACK-1)
 			return;
 		/* Push */
-		m = geo_transform[geo_stack];
+		m = &geo_transform[geo_stack];
 		geo_stack++;
-		geo_transform[geo_stack]->set(m);
+		geo_transform[geo_stack].set(m);
 	}
 	/* Lowers the transformation stack by 1 */
 	void pop()
@@ -88,28 +107,267 @@ namespace Geo
 			return;
 		/* Pop */
 		geo_stack--;
+		geo_dirty = 1;
 	}
 	/* Applies translation */
 	void translate(float x,float y,float z)
 	{
-		geo_adjust->identity();
-		geo_adjust->translate(x,y,z);
-		geo_transform[geo_stack]->multiply(geo_adjust);
+		geo_transform[geo_stack].multiply_translate(x,y,z);
+		geo_dirty = 1;
 	}
 	/* Applies scale */
 	void scale(float sx,float sy,float sz)
 	{
-		geo_adjust->identity();
-		geo_adjust->scale(sx,sy,sz);
-		geo_transform[geo_stack]->multiply(geo_adjust);
+		geo_transform[geo_stack].multiply_scale(sx,sy,sz);
+		geo_dirty = 1;
 	}
-	/* Converts to screen integer */
-	void screen(Vector *v,int *px,int *py)
+	/* Replaces transform */
+	void load(Matrix *m)
+	{
+		geo_transform[geo_stack].set(m);
+		geo_dirty = 1;
+	}
+	/* Applies rotation */
+	void rotate(float angle,float x,float y,float z)
+	{
+		geo_adjust.rotate(angle,x,y,z);
+		geo_transform[geo_stack].multiply_affine(&geo_adjust);
+		geo_dirty = 1;
+	}
+	/* Sets camera view */
+	void look_at(float ex,float ey,float ez,float tx,float ty,float tz,float ux,float uy,float uz)
+	{
+		geo_view.look_at(ex,ey,ez,tx,ty,tz,ux,uy,uz);
+		geo_dirty = 1;
+	}
+	/* Flips projected y so world up is screen up */
+	void flip_projection()
+	{
+		geo_adjust.identity();
+		geo_adjust.scale(1.0f,-1.0f,1.0f);
+		geo_adjust.multiply(&geo_projection);
+		geo_projection.set(&geo_adjust);
+		geo_projected = 1;
+		geo_dirty = 1;
+	}
+	/* Sets perspective projection */
+	void perspective(float fov,float znear,float zfar)
+	{
+		geo_projection.perspective(fov,znear,zfar);
+		flip_projection();
+	}
+	/* Sets orthographic projection */
+	void orthographic(float l,float r,float b,float t,float znear,float zfar)
+	{
+		geo_projection.orthographic(l,r,b,t,znear,zfar);
+		flip_projection();
+	}
+	/* Removes camera */
+	void reset_camera()
+	{
+		geo_view.identity();
+		geo_projection.identity();
+		geo_projected = 0;
+		geo_dirty = 1;
+	}
+	/* Gets the combined matrix, rebuilding it if anything changed */
+	Matrix *get_combined()
+	{
+		Matrix m;
+		if(!geo_dirty)
+			return &geo_combined;
+		/* View and transforms are affine, only the projection needs a full multiply */
+		geo_combined.set(&geo_view);
+		if(geo_transform[geo_stack].is_affine())
+			geo_combined.multiply_affine(&geo_transform[geo_stack]);
+		else
+			geo_combined.multiply(&geo_transform[geo_stack]);
+		if(geo_projected)
+		{
+			m.set(&geo_projection);
+			m.multiply(&geo_combined);
+			geo_combined.set(&m);
+		}
+		geo_dirty = 0;
+		geo_planes_dirty = 1;
+		return &geo_combined;
+	}
+	/* Gets the row of view and current transform giving minus the view depth of a point */
+	void depth_row(float *r)
+	{
+		Matrix *t;
+		int c;
+		t = &geo_transform[geo_stack];
+		for(c = 0;c < 4;c++)
+			r[c] = geo_view.get(2,0)*t->get(0,c)+geo_view.get(2,1)*t->get(1,c)+geo_view.get(2,2)*t->get(2,c)+(c == 3 ? geo_view.get(2,3) : 0.0f);
+	}
+	/* Adds a frustum plane from rows of the combined matrix (a+b*s) */
+	void add_plane(float *a,float *b,float s)
+	{
+		float *p,l;
+		int i;
+		p = &geo_planes[geo_plane_count*4];
+		for(i = 0;i < 4;i++)
+			p[i] = a[i]+b[i]*s;
+		/* Normalize so distances can be compared against radii */
+		l = (float)sqrt(p[0]*p[0]+p[1]*p[1]+p[2]*p[2]);
+		if(l <= 0.0f)
+			return;
+		for(i = 0;i < 4;i++)
+			p[i] /= l;
+		geo_plane_count++;
+	}
+	/* Rebuilds the frustum when the combined matrix changed */
+	void frustum()
+	{
+		float rows[16];
+		Matrix *m;
+		int i;
+		m = get_combined();
+		if(!geo_planes_dirty)
+			return;
+		/* Clip space rows, with x corrected for aspect like screen does */
+		for(i = 0;i < 16;i++)
+			rows[i] = m->get(i>>2,i&3);
+		for(i = 0;i < 4;i++)
+			rows[i] *= geo_screen_scale_x;
+		/* A point is inside while -w <= x,y <= w, and -w <= z <= w once projected */
+		geo_plane_count = 0;
+		add_plane(&rows[12],&rows[0],1.0f);
+		add_plane(&rows[12],&rows[0],-1.0f);
+		add_plane(&rows[12],&rows[4],1.0f);
+		add_plane(&rows[12],&rows[4],-1.0f);
+		if(geo_projected)
+		{
+			add_plane(&rows[12],&rows[8],1.0f);
+			add_plane(&rows[12],&rows[8],-1.0f);
+		}
+		/* Nothing past the fog end can be seen */
+		if(geo_fog)
+		{
+			depth_row(rows);
+			rows[3] += geo_fog_end;
+			for(i = 4;i < 8;i++)
+				rows[i] = 0.0f;
+			add_plane(&rows[0],&rows[4],0.0f);
+		}
+		geo_planes_dirty = 0;
+	}
+	/* Is a sphere outside the view? */
+	int cull_sphere(float *c,float r)
+	{
+		float *p;
+		int i;
+		frustum();
+		for(i = 0;i < geo_plane_count;i++)
+		{
+			p = &geo_planes[i*4];
+			if(p[0]*c[0]+p[1]*c[1]+p[2]*c[2]+p[3] < -r)
+				return 1;
+		}
+		return 0;
+	}
+	/* Is a box outside the view? */
+	int cull_box(float *lo,float *hi)
+	{
+		float *p;
+		int i;
+		frustum();
+		for(i = 0;i < geo_plane_count;i++)
+		{
+			/* Test the corner furthest along the plane normal */
+			p = &geo_planes[i*4];
+			if(p[0]*(p[0] > 0.0f ? hi[0] : lo[0])+p[1]*(p[1] > 0.0f ? hi[1] : lo[1])+p[2]*(p[2] > 0.0f ? hi[2] : lo[2])+p[3] < 0.0f)
+				return 1;
+		}
+		return 0;
+	}
+	/* Are spheres outside the view? */
+	void cull_spheres(int n,float *xs,float *ys,float *zs,float *rs,int *out)
+	{
+		__m128 x,y,z,nr,d,outside;
+		float c[3];
+		int i,j,bits;
+		frustum();
+		/* Four spheres against each plane at a time */
+		for(i = 0;i+4 <= n;i += 4)
+		{
+			x = _mm_loadu_ps(&xs[i]);
+			y = _mm_loadu_ps(&ys[i]);
+			z = _mm_loadu_ps(&zs[i]);
+			nr = _mm_sub_ps(_mm_setzero_ps(),_mm_loadu_ps(&rs[i]));
+			outside = _mm_setzero_ps();
+			for(j = 0;j < geo_plane_count;j++)
+			{
+				d = _mm_mul_ps(x,_mm_set1_ps(geo_planes[j*4]));
+				d = _mm_add_ps(d,_mm_mul_ps(y,_mm_set1_ps(geo_planes[j*4+1])));
+				d = _mm_add_ps(d,_mm_mul_ps(z,_mm_set1_ps(geo_planes[j*4+2])));
+				d = _mm_add_ps(d,_mm_set1_ps(geo_planes[j*4+3]));
+				outside = _mm_or_ps(outside,_mm_cmplt_ps(d,nr));
+			}
+			bits = _mm_movemask_ps(outside);
+			out[i] = bits&1;
+			out[i+1] = (bits>>1)&1;
+			out[i+2] = (bits>>2)&1;
+			out[i+3] = (bits>>3)&1;
+		}
+		/* Leftovers one by one */
+		for(;i < n;i++)
+		{
+			c[0] = xs[i];
+			c[1] = ys[i];
+			c[2] = zs[i];
+			out[i] = cull_sphere(c,rs[i]);
+		}
+	}
+	/* Get size on screen */
+	float screen_size(float *c,float r)
+	{
+		Matrix *m;
+		float w,l;
+		m = get_combined();
+		w = m->get(3,0)*c[0]+m->get(3,1)*c[1]+m->get(3,2)*c[2]+m->get(3,3);
+		if(w <= GEO_NEAR_W)
+			return 3.0e38f;
+		/* Projected y spans the screen height over 2 units, so the diameter is r*scale/w heights */
+		l = (float)sqrt(m->get(1,0)*m->get(1,0)+m->get(1,1)*m->get(1,1)+m->get(1,2)*m->get(1,2));
+		return r*l/w*((float)Video::get_height());
+	}
+	/* Count culled */
+	void count_culled(int objects,int points)
+	{
+		geo_culled_objects += objects;
+		geo_culled_points += points;
+	}
+	/* Get culled object count */
+	int get_culled_objects()
+	{
+		return geo_culled_objects;
+	}
+	/* Get culled point count */
+	int get_culled_points()
+	{
+		return geo_culled_points;
+	}
+	/* Reset culled counts */
+	void reset_culled()
+	{
+		geo_culled_objects = 0;
+		geo_culled_points = 0;
+	}
+	/* Converts a transformed point to screen integer */
+	void screen_point(float *p,int *px,int *py)
 	{
 		float x,y;
 		/* Get point (relative to 0,0) */
-		x = v->get_x();
-		y = v->get_y();
+		x = p[0];
+		y = p[1];
+		/* Perspective divide */
+		if(p[3] != 1.0f && p[3] > 0.0f)
+		{
+			x /= p[3];
+			y /= p[3];
+		}
 		/* If relative to (0,0) then moving it this much shall work */
 		x *= geo_screen_scale_x;
 		x *= 0.5f;
@@ -122,34 +380,114 @@ namespace Geo
 		px[0] = (int)x;
 		py[0] = (int)y;
 	}
-	/* Draw arrays */
-	void draw(int pc,float *ps,int *txs,int *cs,int tc,int *ts)
+	/* Converts to screen integer */
+	void screen(Vector *v,int *px,int *py)
 	{
-		int i,ix,ixx;
-		Vertex2D *va,*vb,*vc;
-		/* Exceeded maximum points */
-		if(pc >= GEO_MAX_POINTS)
-			return;
-		/* Transform points */
-		ix = 0;
-		ixx = 0;
+		float p[4];
+		p[0] = v->get_x();
+		p[1] = v->get_y();
+		p[2] = v->get_z();
+		p[3] = v->get_w();
+		screen_point(p,px,py);
+	}
+	/* Takes room for a draw from the frame arena */
+	int prepare(int pc)
+	{
+		geo_vertex = (Vertex2D*)Video::frame_alloc(sizeof(Vertex2D)*pc);
+		geo_points = (float*)Video::frame_alloc(sizeof(float)*4*pc);
+		return geo_vertex && geo_points;
+	}
+	/* Fills screen vertices from transformed points (ps are the points before transforming) */
+	void finish(int pc,float *ps,int *txs,int *cs)
+	{
+		float r[4],d,k;
+		int i,f;
 		for(i = 0;i < pc;i++)
 		{
-			/* Copy */
-			geo_points[i]->set(ps[ix],ps[ix+1],ps[ix+2],1.0f);
-			/* Transform */
-			transform(geo_points[i]);
-			/* To screen */
-			screen(geo_points[i],&geo_vertex[i].x,&geo_vertex[i].y);
-			/* Place results */
-			geo_vertex[i].u = txs[ixx];
-			geo_vertex[i].v = txs[ixx+1];
+			screen_point(&geo_points[i*4],&geo_vertex[i].x,&geo_vertex[i].y);
+			geo_vertex[i].u = txs[i*2];
+			geo_vertex[i].v = txs[i*2+1];
 			geo_vertex[i].color = cs[i];
-			/* Next */
-			ix += 3;
-			ixx += 2;
+			geo_vertex[i].fog = 0;
 		}
-		/* Render triangles */
+		if(!geo_fog)
+			return;
+		/* Fog amount from view depth */
+		depth_row(r);
+		k = 255.0f/(geo_fog_end-geo_fog_start);
+		for(i = 0;i < pc;i++)
+		{
+			d = -(r[0]*ps[i*3]+r[1]*ps[i*3+1]+r[2]*ps[i*3+2]+r[3]);
+			f = (int)((d-geo_fog_start)*k);
+			if(f < 0) f = 0;
+			if(f > 255) f = 255;
+			geo_vertex[i].fog = f;
+			/* Untextured modes fade their colors once per point instead of every pixel */
+			if(geo_mode&7 && !(geo_mode&DRAW_TEXTURE))
+				geo_vertex[i].color = Draw::fog(cs[i],f);
+		}
+	}
+	/* Draws an edge unless it was drawn already (edges holds pairs of points, -1 for empty) */
+	void render_edge(int a,int b,int *edges,int mask)
+	{
+		Vertex2D *va,*vb;
+		int h,t;
+		if(a > b)
+		{
+			t = a;
+			a = b;
+			b = t;
+		}
+		/* Look for it */
+		h = ((unsigned int)a*2654435761u^(unsigned int)b*40503u)&mask;
+		while(edges[h*2] >= 0)
+		{
+			if(edges[h*2] == a && edges[h*2+1] == b)
+				return;
+			h = (h+1)&mask;
+		}
+		edges[h*2] = a;
+		edges[h*2+1] = b;
+		/* Draw, unless an end is behind the camera or both are lost in fog */
+		va = &geo_vertex[a];
+		vb = &geo_vertex[b];
+		if(geo_points[a*4+3] <= GEO_NEAR_W || geo_points[b*4+3] <= GEO_NEAR_W || (va->fog == 255 && vb->fog == 255))
+			return;
+		Draw::line(va->x,va->y,vb->x,vb->y,va->color,geo_mode&(DRAW_BLEND|DRAW_BLEND_OPS));
+	}
+	/* Renders triangle edges from the projected vertices */
+	void render_edges(int tc,int *ts)
+	{
+		int i,size,*edges;
+		/* Table of drawn edges, never more than half full */
+		size = 16;
+		while(size < tc*6)
+			size <<= 1;
+		edges = (int*)Video::frame_alloc(sizeof(int)*2*size);
+		if(!edges)
+			return;
+		memset(edges,0xFF,sizeof(int)*2*size);
+		for(i = 0;i < tc*3;i += 3)
+		{
+			render_edge(ts[i],ts[i+1],edges,size-1);
+			render_edge(ts[i+1],ts[i+2],edges,size-1);
+			render_edge(ts[i+2],ts[i],edges,size-1);
+		}
+	}
+	/* Renders triangles from the projected vertices */
+	void render(int tc,int *ts)
+	{
+		int i,ix,m;
+		if(geo_wireframe)
+		{
+			render_edges(tc,ts);
+			return;
+		}
+		Vertex2D *va,*vb,*vc;
+		/* Textured modes fade each pixel */
+		m = geo_mode;
+		if(geo_fog && (!(m&7) || (m&DRAW_TEXTURE)))
+			m |= DRAW_FOG;
 		ix = 0;
 		for(i = 0;i < tc;i++)
 		{
@@ -157,16 +495,296 @@ namespace Geo
 			va = &geo_vertex[ts[ix]];
 			vb = &geo_vertex[ts[ix+1]];
 			vc = &geo_vertex[ts[ix+2]];
-			/* Draw */
-			Draw::triangle(va,vb,vc,geo_texture,geo_mode);
+			/* Draw, unless part of it is behind the camera or it is lost in fog */
+			if(geo_points[ts[ix]*4+3] > GEO_NEAR_W && geo_points[ts[ix+1]*4+3] > GEO_NEAR_W && geo_points[ts[ix+2]*4+3] > GEO_NEAR_W &&
+			   (va->fog < 255 || vb->fog < 255 || vc->fog < 255))
+				Draw::triangle(va,vb,vc,geo_texture,m);
 			/* Next */
 			ix += 3;
 		}
 	}
+	/* Draw arrays */
+	void draw(int pc,float *ps,int *txs,int *cs,int tc,int *ts)
+	{
+		int mark;
+		/* Room for transformed points and vertices */
+		mark = Video::get_arena()->get_mark();
+		if(!prepare(pc))
+		{
+			Video::get_arena()->rewind(mark);
+			return;
+		}
+		/* Transform all points at once, then place on screen */
+		get_combined()->transform_points(pc,ps,geo_points);
+		finish(pc,ps,txs,cs);
+		/* Render triangles */
+		render(tc,ts);
+		/* Vertices are only needed while drawing */
+		Video::get_arena()->rewind(mark);
+	}
+	/* Draw lit arrays */
+	void draw_lit(int pc,float *ps,float *ns,int *txs,int *cs,int tc,int *ts,GeoLightCache *cache)
+	{
+		int i,mark,*lit;
+		Matrix *m;
+		m = &geo_transform[geo_stack];
+		/* Still lit with the same lights in the same place? */
+		if(cache && cache->colors)
+		{
+			if(cache->generation == geo_light_generation)
+			{
+				for(i = 0;i < 12;i++)
+				{
+					if(cache->transform[i] != m->get(i>>2,i&3))
+						break;
+				}
+				if(i == 12)
+				{
+					draw(pc,ps,txs,cache->colors,tc,ts);
+					return;
+				}
+			}
+			light(pc,ps,ns,cs,cache->colors);
+			cache->generation = geo_light_generation;
+			for(i = 0;i < 12;i++)
+				cache->transform[i] = m->get(i>>2,i&3);
+			draw(pc,ps,txs,cache->colors,tc,ts);
+			return;
+		}
+		/* Lit colors only last for this draw */
+		mark = Video::get_arena()->get_mark();
+		lit = (int*)Video::frame_alloc(sizeof(int)*pc);
+		if(lit)
+		{
+			light(pc,ps,ns,cs,lit);
+			draw(pc,ps,txs,lit,tc,ts);
+		}
+		Video::get_arena()->rewind(mark);
+	}
+	/* Draw arrays with quantized points */
+	void draw_quantized(int pc,short *ps,float *qscale,float *qbias,int *txs,int *cs,int tc,int *ts)
+	{
+		int i,mark;
+		float *fs;
+		/* Room for converted and transformed points and vertices */
+		mark = Video::get_arena()->get_mark();
+		fs = (float*)Video::frame_alloc(sizeof(float)*3*pc);
+		if(!fs || !prepare(pc))
+		{
+			Video::get_arena()->rewind(mark);
+			return;
+		}
+		for(i = 0;i < pc*3;i++)
+			fs[i] = (float)ps[i];
+		/* Fold dequantization into the transform so each point is only converted to float */
+		push();
+		translate(qbias[0],qbias[1],qbias[2]);
+		scale(qscale[0],qscale[1],qscale[2]);
+		get_combined()->transform_points(pc,fs,geo_points);
+		finish(pc,fs,txs,cs);
+		pop();
+		/* Render triangles */
+		render(tc,ts);
+		/* Vertices are only needed while drawing */
+		Video::get_arena()->rewind(mark);
+	}
+	/* Set wireframe */
+	void wireframe(int w)
+	{
+		geo_wireframe = w;
+	}
+	/* Set fog */
+	void fog(int c,float start,float end)
+	{
+		geo_fog = end > start;
+		geo_fog_start = start;
+		geo_fog_end = end;
+		Draw::fog_color(c);
+		geo_planes_dirty = 1;
+	}
+	/* Converts a color to light */
+	void color_light(int c,float *l)
+	{
+		l[0] = ((float)(c&0xFF))/255.0f;
+		l[1] = ((float)((c>>8)&0xFF))/255.0f;
+		l[2] = ((float)((c>>16)&0xFF))/255.0f;
+	}
+	/* Set ambient light */
+	void ambient(int c)
+	{
+		color_light(c,geo_ambient);
+		geo_light_generation++;
+	}
+	/* Add light */
+	int add_light(int type,float x,float y,float z,float range,int c)
+	{
+		GeoLight *l;
+		float f[3];
+		if(geo_light_count >= GEO_MAX_LIGHTS)
+			return GEO_ERROR_LIGHTS;
+		l = &geo_lights[geo_light_count];
+		l->type = type;
+		l->range = range;
+		color_light(c,f);
+		l->r = f[0];
+		l->g = f[1];
+		l->b = f[2];
+		move_light(geo_light_count,x,y,z);
+		return geo_light_count++;
+	}
+	/* Add directional light */
+	int light_directional(float x,float y,float z,int c)
+	{
+		return add_light(GEO_LIGHT_DIRECTIONAL,x,y,z,0.0f,c);
+	}
+	/* Add point light */
+	int light_point(float x,float y,float z,float range,int c)
+	{
+		if(range <= 0.0f)
+			range = 1.0f;
+		return add_light(GEO_LIGHT_POINT,x,y,z,range,c);
+	}
+	/* Move light */
+	void move_light(int l,float x,float y,float z)
+	{
+		float d;
+		if(l < 0 || l >= GEO_MAX_LIGHTS)
+			return;
+		/* Directions are kept unit length */
+		if(geo_lights[l].type == GEO_LIGHT_DIRECTIONAL)
+		{
+			d = sqrtf(x*x+y*y+z*z);
+			if(d > 0.0f)
+			{
+				x /= d;
+				y /= d;
+				z /= d;
+			}
+		}
+		geo_lights[l].x = x;
+		geo_lights[l].y = y;
+		geo_lights[l].z = z;
+		geo_light_generation++;
+	}
+	/* Remove lights */
+	void clear_lights()
+	{
+		geo_light_count = 0;
+		geo_ambient[0] = 0.25f;
+		geo_ambient[1] = 0.25f;
+		geo_ambient[2] = 0.25f;
+		geo_light_generation++;
+	}
+	/* Get light generation */
+	int get_light_generation()
+	{
+		return geo_light_generation;
+	}
+	/* Light points */
+	void light(int pc,float *ps,float *ns,int *cs,int *out)
+	{
+		float a[9],t[3],d,s,q[GEO_MAX_LIGHTS*4],*p,*n;
+		int i,j,k,ix[4],lc[4];
+		__m128 px,py,pz,nx,ny,nz,r,g,b,dx,dy,dz,dd,inv,f,zero,one;
+		Matrix *m;
+		GeoLight *l;
+		/* Inverse of the transform (linear part by cofactors) */
+		m = &geo_transform[geo_stack];
+		a[0] = m->get(1,1)*m->get(2,2)-m->get(1,2)*m->get(2,1);
+		a[1] = m->get(0,2)*m->get(2,1)-m->get(0,1)*m->get(2,2);
+		a[2] = m->get(0,1)*m->get(1,2)-m->get(0,2)*m->get(1,1);
+		a[3] = m->get(1,2)*m->get(2,0)-m->get(1,0)*m->get(2,2);
+		a[4] = m->get(0,0)*m->get(2,2)-m->get(0,2)*m->get(2,0);
+		a[5] = m->get(0,2)*m->get(1,0)-m->get(0,0)*m->get(1,2);
+		a[6] = m->get(1,0)*m->get(2,1)-m->get(1,1)*m->get(2,0);
+		a[7] = m->get(0,1)*m->get(2,0)-m->get(0,0)*m->get(2,1);
+		a[8] = m->get(0,0)*m->get(1,1)-m->get(0,1)*m->get(1,0);
+		d = m->get(0,0)*a[0]+m->get(0,1)*a[3]+m->get(0,2)*a[6];
+		if(d == 0.0f)
+			d = 1.0f;
+		for(i = 0;i < 9;i++)
+			a[i] /= d;
+		/* Even scale of the transform */
+		s = sqrtf(m->get(0,0)*m->get(0,0)+m->get(1,0)*m->get(1,0)+m->get(2,0)*m->get(2,0));
+		if(s == 0.0f)
+			s = 1.0f;
+		/* Move lights into the space of the points (toward the light for directional ones) */
+		for(k = 0;k < geo_light_count;k++)
+		{
+			l = &geo_lights[k];
+			if(l->type == GEO_LIGHT_DIRECTIONAL)
+			{
+				t[0] = -l->x*s;
+				t[1] = -l->y*s;
+				t[2] = -l->z*s;
+				q[k*4+3] = 0.0f;
+			}
+			else
+			{
+				t[0] = l->x-m->get(0,3);
+				t[1] = l->y-m->get(1,3);
+				t[2] = l->z-m->get(2,3);
+				q[k*4+3] = s/l->range;
+			}
+			for(j = 0;j < 3;j++)
+				q[k*4+j] = a[j*3]*t[0]+a[j*3+1]*t[1]+a[j*3+2]*t[2];
+		}
+		zero = _mm_setzero_ps();
+		one = _mm_set1_ps(1.0f);
+		/* Four points at a time, the last group repeats the last point */
+		for(i = 0;i < pc;i += 4)
+		{
+			for(j = 0;j < 4;j++)
+				ix[j] = (i+j < pc) ? (i+j)*3 : (pc-1)*3;
+			p = ps;
+			n = ns;
+			px = _mm_set_ps(p[ix[3]],p[ix[2]],p[ix[1]],p[ix[0]]);
+			py = _mm_set_ps(p[ix[3]+1],p[ix[2]+1],p[ix[1]+1],p[ix[0]+1]);
+			pz = _mm_set_ps(p[ix[3]+2],p[ix[2]+2],p[ix[1]+2],p[ix[0]+2]);
+			nx = _mm_set_ps(n[ix[3]],n[ix[2]],n[ix[1]],n[ix[0]]);
+			ny = _mm_set_ps(n[ix[3]+1],n[ix[2]+1],n[ix[1]+1],n[ix[0]+1]);
+			nz = _mm_set_ps(n[ix[3]+2],n[ix[2]+2],n[ix[1]+2],n[ix[0]+2]);
+			r = _mm_set1_ps(geo_ambient[0]);
+			g = _mm_set1_ps(geo_ambient[1]);
+			b = _mm_set1_ps(geo_ambient[2]);
+			for(k = 0;k < geo_light_count;k++)
+			{
+				l = &geo_lights[k];
+				if(l->type == GEO_LIGHT_DIRECTIONAL)
+				{
+					/* Facing the light */
+					f = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx,_mm_set1_ps(q[k*4])),_mm_mul_ps(ny,_mm_set1_ps(q[k*4+1]))),_mm_mul_ps(nz,_mm_set1_ps(q[k*4+2])));
+					f = _mm_max_ps(f,zero);
+				}
+				else
+				{
+					/* Facing the light, fading out linearly to its range */
+					dx = _mm_sub_ps(_mm_set1_ps(q[k*4]),px);
+					dy = _mm_sub_ps(_mm_set1_ps(q[k*4+1]),py);
+					dz = _mm_sub_ps(_mm_set1_ps(q[k*4+2]),pz);
+					dd = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx,dx),_mm_mul_ps(dy,dy)),_mm_mul_ps(dz,dz));
+					inv = _mm_rsqrt_ps(_mm_max_ps(dd,_mm_set1_ps(1e-12f)));
+					f = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx,dx),_mm_mul_ps(ny,dy)),_mm_mul_ps(nz,dz)),inv);
+					f = _mm_mul_ps(_mm_max_ps(f,zero),_mm_max_ps(_mm_sub_ps(one,_mm_mul_ps(_mm_mul_ps(dd,inv),_mm_set1_ps(q[k*4+3]))),zero));
+				}
+				r = _mm_add_ps(r,_mm_mul_ps(f,_mm_set1_ps(l->r)));
+				g = _mm_add_ps(g,_mm_mul_ps(f,_mm_set1_ps(l->g)));
+				b = _mm_add_ps(b,_mm_mul_ps(f,_mm_set1_ps(l->b)));
+			}
+			/* Pack light into a color and multiply the point colors by it */
+			f = _mm_set1_ps(255.0f);
+			r = _mm_mul_ps(_mm_min_ps(r,one),f);
+			g = _mm_mul_ps(_mm_min_ps(g,one),f);
+			b = _mm_mul_ps(_mm_min_ps(b,one),f);
+			_mm_storeu_si128((__m128i*)lc,_mm_or_si128(_mm_or_si128(_mm_cvtps_epi32(r),_mm_slli_epi32(_mm_cvtps_epi32(g),8)),_mm_or_si128(_mm_slli_epi32(_mm_cvtps_epi32(b),16),_mm_set1_epi32(0xFF000000))));
+			for(j = 0;j < 4 && i+j < pc;j++)
+				out[i+j] = Draw::multiply_color(cs[i+j],lc[j]);
+		}
+	}
 	/* Transforms vector */
 	void transform(Vector *v)
 	{
-		v->multiply(geo_transform[geo_stack]);
+		v->multiply(get_combined());
 	}
 	/* Specify texture */
 	void texture(Texture *t)
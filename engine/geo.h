@@ -3,12 +3,50 @@
 
 /* Defines */
 #define GEO_MATRIX_STACK 16
-#define GEO_MAX_POINTS 256
+#define GEO_NEAR_W 0.0001f /* Triangles with a point at or behind this w are not drawn */
+#define GEO_MAX_PLANES 7 /* Frustum planes (near and far only exist with a projection, fog end only with fog) */
+#define GEO_MAX_LIGHTS 8
+
+/* Light types */
+#define GEO_LIGHT_DIRECTIONAL 0
+#define GEO_LIGHT_POINT 1
+
+/* Error codes */
+#define GEO_ERROR_LIGHTS -1
 
 /* Includes */
 #include "vector.h"
 #include "draw.h"
 
+/* REMARKS: */
+/*
+	Without a camera, transformed points map straight to the screen with y pointing down.
+	With a projection, y points up like world space and the camera looks down -z.
+	Transforms are only ever built from translations, scales and rotations, so they stay affine
+	and are combined with the cheaper affine multiply. The projection, view and current transform
+	are cached together and only recombined when one of them changes.
+	Frustum planes come from the same combined matrix, so culling tests bounding volumes
+	in the space of the current transform without transforming a single point.
+	Lights live in world space (the space of the current transform before the camera), they are moved
+	into the space of the points once per draw so lighting never transforms a normal.
+	Lighting assumes transforms scale evenly on every axis.
+	Lit colors are the point colors multiplied by the light reaching them (ambient plus every light).
+	A light cache keeps the colors of a static mesh and is only relit when a light changed
+	or the mesh moved, the camera can move freely.
+	Fog grows with view depth (distance in front of the camera) from its start to its end.
+	Untextured Gouraud modes fade their vertex colors, so fog costs them nothing per pixel,
+	other modes get DRAW_FOG added. Fog end also becomes a frustum plane and triangles wholly past it
+	are skipped, so pull it in to save geometry work, and clear the screen to the fog color.
+*/
+
+/* Lit colors kept between draws */
+typedef struct
+{
+	int generation; /* Light generation the colors were lit with (0 until first lit) */
+	float transform[12]; /* Transform they were lit with */
+	int *colors; /* Lit colors, one per point (allocated by the owner) */
+}GeoLightCache;
+
 /* Geo */
 namespace Geo
 {
@@ -32,6 +70,11 @@ namespace Geo
 		Returns to the previous transform
 	*/
 	extern void pop();
+	/*
+		Replaces the current transform
+		m - the new transform
+	*/
+	extern void load(Matrix *m);
 	/*
 		Applies a translation
 	*/
@@ -40,6 +83,82 @@ namespace Geo
 		Applies a scale
 	*/
 	extern void scale(float sx,float sy,float sz);
+	/*
+		Applies a rotation
+		angle - rotation (in degrees)
+		x,y,z - axis to rotate around
+	*/
+	extern void rotate(float angle,float x,float y,float z);
+	/*
+		Places the camera
+		ex,ey,ez - camera position
+		tx,ty,tz - point to look at
+		ux,uy,uz - which way is up
+	*/
+	extern void look_at(float ex,float ey,float ez,float tx,float ty,float tz,float ux,float uy,float uz);
+	/*
+		Sets a perspective projection, aspect ratio is corrected when placing on screen
+		fov - vertical field of view (in degrees)
+		znear,zfar - distance to near and far planes
+	*/
+	extern void perspective(float fov,float znear,float zfar);
+	/*
+		Sets an orthographic projection, aspect ratio is corrected when placing on screen
+		l,r,b,t - left, right, bottom and top of view volume
+		znear,zfar - distance to near and far planes
+	*/
+	extern void orthographic(float l,float r,float b,float t,float znear,float zfar);
+	/*
+		Removes the camera view and projection, so transformed points map straight to the screen
+	*/
+	extern void reset_camera();
+	/*
+		Gets the projection, view and current transform combined
+		It is cached and only rebuilt after something changed
+	*/
+	extern Matrix *get_combined();
+	/*
+		Tests a sphere in the space of the current transform against the view
+		Returns 1 if it is entirely outside, 0 if it may be seen
+		c - center (3 floats)
+		r - radius
+	*/
+	extern int cull_sphere(float *c,float r);
+	/*
+		Tests a box in the space of the current transform against the view
+		Returns 1 if it is entirely outside, 0 if it may be seen
+		lo,hi - corners (3 floats each)
+	*/
+	extern int cull_box(float *lo,float *hi);
+	/*
+		Tests many spheres in the space of the current transform against the view, four at a time
+		n - count of spheres
+		xs,ys,zs,rs - centers and radii
+		out - 1 for each sphere entirely outside, 0 for those that may be seen
+	*/
+	extern void cull_spheres(int n,float *xs,float *ys,float *zs,float *rs,int *out);
+	/*
+		Gets how tall a sphere in the space of the current transform looks on screen
+		Returns its height in pixels (very large when it reaches behind the camera)
+		c - center (3 floats)
+		r - radius
+	*/
+	extern float screen_size(float *c,float r);
+	/*
+		Adds to the culled counts
+		objects - count of objects culled
+		points - count of their points
+	*/
+	extern void count_culled(int objects,int points);
+	/*
+		Gets the culled counts for the current frame
+	*/
+	extern int get_culled_objects();
+	extern int get_culled_points();
+	/*
+		Resets culled counts (at the start of every frame)
+	*/
+	extern void reset_culled();
 	/*
 		Converts from a point in world space to screen space
 		Only works on finally transformed vectors
@@ -57,9 +176,66 @@ namespace Geo
 		Sets current mode
 	*/
 	extern void mode(int m);
+	/*
+		Sets wireframe drawing, where triangles only draw their edges as lines
+		Each edge shared by several triangles of one draw is only drawn once,
+		lines use the color of their first point and blend when the mode does
+		w - 1 for wireframe, 0 for filled triangles
+	*/
+	extern void wireframe(int w);
+	/*
+		Sets depth fog
+		c - fog color
+		start,end - view depths where fog starts and where it is full (end <= start turns fog off)
+	*/
+	extern void fog(int c,float start,float end);
+	/*
+		Sets the ambient light
+		c - light color
+	*/
+	extern void ambient(int c);
+	/*
+		Adds a directional light
+		Returns light index or error code
+		x,y,z - direction it shines in (world space)
+		c - light color
+	*/
+	extern int light_directional(float x,float y,float z,int c);
+	/*
+		Adds a point light
+		Returns light index or error code
+		x,y,z - position (world space)
+		range - distance at which it fades out
+		c - light color
+	*/
+	extern int light_point(float x,float y,float z,float range,int c);
+	/*
+		Moves a light
+		l - the light
+		x,y,z - new direction or position
+	*/
+	extern void move_light(int l,float x,float y,float z);
+	/*
+		Removes every light and resets ambient light
+	*/
+	extern void clear_lights();
+	/*
+		Gets the light generation, which changes every time a light changes
+	*/
+	extern int get_light_generation();
+	/*
+		Lights points, four at a time with SSE
+		pc - count of points
+		ps - the points (3 floats each)
+		ns - their normals (3 floats each, unit length)
+		cs - their colors
+		out - lit colors
+	*/
+	extern void light(int pc,float *ps,float *ns,int *cs,int *out);
 	/*
 		Draws an array of triangles
-		Will not render anything with more than GEO_MAX_POINTS points in it
+		Projected vertices are kept in the frame arena while drawing,
+		nothing is rendered if they do not fit
 		pc - count of points
 		ps - the points
 		txs - the texture coordinates
@@ -68,6 +244,32 @@ namespace Geo
 		ts - the triangles
 	*/
 	extern void draw(int pc,float *ps,int *txs,int *cs,int tc,int *ts);
+	/*
+		Draws an array of lit triangles
+		Nothing is rendered if the lit colors or projected vertices do not fit in the frame arena
+		pc - count of points
+		ps - the points
+		ns - the normals (3 floats per point)
+		txs - the texture coordinates
+		cs - the colors
+		tc - count of triangles
+		ts - the triangles
+		cache - lit colors to reuse while nothing changed (0 to always light)
+	*/
+	extern void draw_lit(int pc,float *ps,float *ns,int *txs,int *cs,int tc,int *ts,GeoLightCache *cache);
+	/*
+		Draws an array of triangles whose points are quantized to 16-bit integers
+		Each point is dequantized as p*qscale+qbias, which is folded into the transform
+		Nothing is rendered if the projected vertices do not fit in the frame arena
+		pc - count of points
+		ps - the quantized points
+		qscale,qbias - dequantization scale and bias (3 components each)
+		txs - the texture coordinates
+		cs - the colors
+		tc - count of triangles
+		ts - the triangles
+	*/
+	extern void draw_quantized(int pc,short *ps,float *qscale,float *qbias,int *txs,int *cs,int tc,int *ts);
 }
 
 #endif
\ No newline at end of file
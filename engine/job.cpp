@@ -0,0 +1,177 @@
+/*
+	Job - Worker threads for splitting frame work
+*/
+
+/* Includes */
+#include <SDL.h>
+#include "job.h"
+
+/* Job */
+namespace Job
+{
+	/* Globals */
+	SDL_Thread *job_workers[JOB_MAX_WORKERS]; /* Worker threads */
+	int job_worker_count = 0; /* Count of running workers */
+	SDL_mutex *job_lock = 0; /* Guards the job description and the quit flag */
+	SDL_cond *job_signal = 0; /* Wakes workers when a job starts or on quit */
+	SDL_cond *job_finished = 0; /* Wakes the caller when the last item is done */
+	JobFunction job_function = 0; /* Current job */
+	void *job_data = 0;
+	int job_count = 0;
+	int job_generation = 0; /* Bumped for every job, so workers can tell a new one started */
+	SDL_atomic_t job_next; /* Next item to hand out */
+	SDL_atomic_t job_done; /* Items finished */
+	int job_busy = 0; /* Workers taking items (guarded by the lock) */
+	int job_quit = 0; /* Workers should exit */
+	int job_active = 0; /* Pool started? */
+	/* Takes items until there are none left */
+	void work()
+	{
+		int i;
+		while(1)
+		{
+			i = SDL_AtomicAdd(&job_next,1);
+			if(i >= job_count)
+				break;
+			job_function(job_data,i);
+			/* Whoever finishes the last item wakes the caller */
+			if(SDL_AtomicAdd(&job_done,1)+1 == job_count)
+			{
+				SDL_LockMutex(job_lock);
+				SDL_CondSignal(job_finished);
+				SDL_UnlockMutex(job_lock);
+			}
+		}
+	}
+	/* Worker thread */
+	int worker(void *data)
+	{
+		int seen;
+		SDL_LockMutex(job_lock);
+		seen = job_generation;
+		while(1)
+		{
+			/* Wait for a new job */
+			while(job_generation == seen && !job_quit)
+				SDL_CondWait(job_signal,job_lock);
+			if(job_quit)
+				break;
+			seen = job_generation;
+			job_busy++;
+			SDL_UnlockMutex(job_lock);
+			work();
+			SDL_LockMutex(job_lock);
+			job_busy--;
+			if(!job_busy)
+				SDL_CondSignal(job_finished);
+		}
+		SDL_UnlockMutex(job_lock);
+		return 0;
+	}
+	/* Start workers */
+	int start(int workers)
+	{
+		int i;
+		/* Already started? */
+		if(job_active)
+			return JOB_ALREADY_STARTED;
+		/* The calling thread works too */
+		if(workers <= 0)
+			workers = SDL_GetCPUCount()-1;
+		if(workers < 0)
+			workers = 0;
+		if(workers > JOB_MAX_WORKERS)
+			workers = JOB_MAX_WORKERS;
+		/* Sync objects */
+		job_lock = SDL_CreateMutex();
+		job_signal = SDL_CreateCond();
+		job_finished = SDL_CreateCond();
+		if(!job_lock || !job_signal || !job_finished)
+		{
+			if(job_lock) SDL_DestroyMutex(job_lock);
+			if(job_signal) SDL_DestroyCond(job_signal);
+			if(job_finished) SDL_DestroyCond(job_finished);
+			job_lock = 0;
+			job_signal = 0;
+			job_finished = 0;
+			return JOB_THREAD_FAILURE;
+		}
+		/* Threads */
+		job_quit = 0;
+		job_count = 0;
+		SDL_AtomicSet(&job_next,0);
+		SDL_AtomicSet(&job_done,0);
+		job_active = 1;
+		job_worker_count = 0;
+		for(i = 0;i < workers;i++)
+		{
+			job_workers[i] = SDL_CreateThread(worker,"job",0);
+			if(!job_workers[i])
+			{
+				stop();
+				return JOB_THREAD_FAILURE;
+			}
+			job_worker_count++;
+		}
+		return 0;
+	}
+	/* Stop workers */
+	void stop()
+	{
+		int i;
+		if(!job_active)
+			return;
+		/* Wake everyone up to quit */
+		SDL_LockMutex(job_lock);
+		job_quit = 1;
+		SDL_CondBroadcast(job_signal);
+		SDL_UnlockMutex(job_lock);
+		for(i = 0;i < job_worker_count;i++)
+			SDL_WaitThread(job_workers[i],0);
+		job_worker_count = 0;
+		SDL_DestroyCond(job_finished);
+		SDL_DestroyCond(job_signal);
+		SDL_DestroyMutex(job_lock);
+		job_finished = 0;
+		job_signal = 0;
+		job_lock = 0;
+		job_active = 0;
+	}
+	/* Run job */
+	void run(int count,JobFunction f,void *data)
+	{
+		int i;
+		if(count <= 0)
+			return;
+		/* Nobody to share with */
+		if(!job_active || !job_worker_count || count == 1)
+		{
+			for(i = 0;i < count;i++)
+				f(data,i);
+			return;
+		}
+		/* Describe the job before handing out items (no worker may still be taking items of the last one) */
+		SDL_LockMutex(job_lock);
+		while(job_busy)
+			SDL_CondWait(job_finished,job_lock);
+		job_function = f;
+		job_data = data;
+		job_count = count;
+		SDL_AtomicSet(&job_done,0);
+		SDL_AtomicSet(&job_next,0);
+		job_generation++;
+		SDL_CondBroadcast(job_signal);
+		SDL_UnlockMutex(job_lock);
+		/* Help out, then wait for the stragglers */
+		work();
+		SDL_LockMutex(job_lock);
+		while(SDL_AtomicGet(&job_done) < count)
+			SDL_CondWait(job_finished,job_lock);
+		SDL_UnlockMutex(job_lock);
+	}
+	/* Get worker count */
+	int get_worker_count()
+	{
+		return job_worker_count;
+	}
+}
\ No newline at end of file
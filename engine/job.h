@@ -0,0 +1,50 @@
+#ifndef JOB_H
+#define JOB_H
+
+/* Defines */
+#define JOB_MAX_WORKERS 8
+
+/* Error codes */
+#define JOB_ALREADY_STARTED -1
+#define JOB_THREAD_FAILURE -2
+
+/* REMARKS: */
+/*
+	A pool of worker threads for splitting frame work (like skinning many characters) across processors.
+	Job::run hands out the items of one job to the workers and the calling thread alike,
+	and only returns once every item is done, so the caller never has to synchronize anything itself.
+	Items are taken one at a time, uneven items balance out on their own.
+	Without workers (or before start) jobs simply run on the calling thread.
+	Jobs should only be run from the main thread, and item functions must not run jobs themselves.
+*/
+
+/* Job item function, called once for every item of a job */
+typedef void (*JobFunction)(void *data,int item);
+
+/* Job */
+namespace Job
+{
+	/*
+		Starts the worker threads
+		Returns result code
+		workers - count of worker threads (0 picks from processor count)
+	*/
+	extern int start(int workers);
+	/*
+		Stops the worker threads
+	*/
+	extern void stop();
+	/*
+		Runs a job and waits for it to finish
+		count - count of items
+		f - function called for each item
+		data - passed to every call
+	*/
+	extern void run(int count,JobFunction f,void *data);
+	/*
+		Gets count of worker threads (not counting the calling thread)
+	*/
+	extern int get_worker_count();
+}
+
+#endif
\ No newline at end of file
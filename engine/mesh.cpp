@@ -0,0 +1,512 @@
+/*
+	Mesh - Binary mesh files mapped straight into memory for drawing
+*/
+
+/* Includes */
+#include <stdio.h>
+#include <memory.h>
+#include <math.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "mesh.h"
+#include "geo.h"
+#include "video.h"
+#include "occlusion.h"
+
+/* Rounds an offset up to stream alignment */
+static int mesh_align(int o)
+{
+	return (o+MESH_ALIGN-1)&~(MESH_ALIGN-1);
+}
+
+/* Checks that a stream lies within the file and is aligned */
+static int mesh_stream_valid(int offset,int length,int size)
+{
+	if(offset < (int)sizeof(MeshHeader) || (offset&(MESH_ALIGN-1)))
+		return 0;
+	if(length < 0 || offset > size-length)
+		return 0;
+	return 1;
+}
+
+/* New mesh */
+Mesh :: Mesh()
+{
+	map = 0;
+	map_size = 0;
+	unload();
+}
+
+/* Delete mesh */
+Mesh :: ~Mesh()
+{
+	unload();
+}
+
+/* Load mesh file */
+int Mesh :: load(const char *path)
+{
+	MeshHeader *h;
+	int size,ps,i;
+	/* Drop old contents */
+	unload();
+	/* Map the whole file */
+#ifdef _WIN32
+	HANDLE file,mapping;
+	LARGE_INTEGER length;
+	file = CreateFileA(path,GENERIC_READ,FILE_SHARE_READ,0,OPEN_EXISTING,FILE_FLAG_RANDOM_ACCESS,0);
+	if(file == INVALID_HANDLE_VALUE)
+		return MESH_OPEN_FAILURE;
+	if(!GetFileSizeEx(file,&length) || length.QuadPart < (LONGLONG)sizeof(MeshHeader) || length.QuadPart > 0x7FFFFFFF)
+	{
+		CloseHandle(file);
+		return MESH_FORMAT_FAILURE;
+	}
+	size = (int)length.QuadPart;
+	mapping = CreateFileMappingA(file,0,PAGE_READONLY,0,0,0);
+	CloseHandle(file);
+	if(!mapping)
+		return MESH_MAP_FAILURE;
+	map = MapViewOfFile(mapping,FILE_MAP_READ,0,0,0);
+	CloseHandle(mapping); /* The view keeps the mapping alive */
+	if(!map)
+		return MESH_MAP_FAILURE;
+#else
+	struct stat st;
+	int fd;
+	fd = open(path,O_RDONLY);
+	if(fd < 0)
+		return MESH_OPEN_FAILURE;
+	if(fstat(fd,&st) || st.st_size < (off_t)sizeof(MeshHeader) || st.st_size > 0x7FFFFFFF)
+	{
+		close(fd);
+		return MESH_FORMAT_FAILURE;
+	}
+	size = (int)st.st_size;
+	map = mmap(0,size,PROT_READ,MAP_PRIVATE,fd,0);
+	close(fd); /* The mapping keeps the file alive */
+	if(map == MAP_FAILED)
+	{
+		map = 0;
+		return MESH_MAP_FAILURE;
+	}
+	/* Ask for the whole file to be read ahead, the first draw would fault it in anyway */
+	madvise(map,size,MADV_WILLNEED);
+#endif
+	map_size = size;
+	/* Check header */
+	h = (MeshHeader*)map;
+	if(h->magic != MESH_MAGIC || h->version != MESH_VERSION || h->size > size)
+	{
+		unload();
+		return MESH_FORMAT_FAILURE;
+	}
+	if(h->point_count < 0 || h->triangle_count < 0 || h->point_count > 0x1000000 || h->triangle_count > 0x1000000)
+	{
+		unload();
+		return MESH_FORMAT_FAILURE;
+	}
+	/* Check streams */
+	if(h->flags&MESH_QUANTIZED)
+		ps = h->point_count*3*sizeof(short);
+	else
+		ps = h->point_count*3*sizeof(float);
+	if(!mesh_stream_valid(h->points,ps,size) ||
+	   !mesh_stream_valid(h->coords,h->point_count*2*sizeof(int),size) ||
+	   !mesh_stream_valid(h->colors,h->point_count*sizeof(int),size) ||
+	   !mesh_stream_valid(h->triangles,h->triangle_count*3*sizeof(int),size))
+	{
+		unload();
+		return MESH_FORMAT_FAILURE;
+	}
+	if(h->lod_count < 1 || h->lod_count > MESH_MAX_LODS)
+	{
+		unload();
+		return MESH_FORMAT_FAILURE;
+	}
+	for(i = 1;i < h->lod_count;i++)
+	{
+		if(h->lod_counts[i] < 0 || h->lod_counts[i] > 0x1000000 || !mesh_stream_valid(h->lod_triangles[i],h->lod_counts[i]*3*sizeof(int),size))
+		{
+			unload();
+			return MESH_FORMAT_FAILURE;
+		}
+	}
+	/* Point straight into the mapping */
+	flags = h->flags;
+	point_count = h->point_count;
+	triangle_count = h->triangle_count;
+	if(flags&MESH_QUANTIZED)
+		packed = (short*)((char*)map+h->points);
+	else
+		points = (float*)((char*)map+h->points);
+	coords = (int*)((char*)map+h->coords);
+	colors = (int*)((char*)map+h->colors);
+	triangles = (int*)((char*)map+h->triangles);
+	memcpy(scale,h->scale,sizeof(scale));
+	memcpy(bias,h->bias,sizeof(bias));
+	memcpy(center,h->center,sizeof(center));
+	radius = h->radius;
+	memcpy(box_min,h->box_min,sizeof(box_min));
+	memcpy(box_max,h->box_max,sizeof(box_max));
+	lod_count = h->lod_count;
+	lod_triangles[0] = triangles;
+	lod_counts[0] = triangle_count;
+	lod_below[0] = 0.0f;
+	for(i = 1;i < lod_count;i++)
+	{
+		lod_triangles[i] = (int*)((char*)map+h->lod_triangles[i]);
+		lod_counts[i] = h->lod_counts[i];
+		lod_below[i] = h->lod_below[i];
+	}
+	return 0;
+}
+
+/* Use arrays */
+void Mesh :: set(int pc,float *ps,int *txs,int *cs,int tc,int *ts)
+{
+	unload();
+	point_count = pc;
+	triangle_count = tc;
+	points = ps;
+	coords = txs;
+	colors = cs;
+	triangles = ts;
+	lod_triangles[0] = ts;
+	lod_counts[0] = tc;
+	bound();
+}
+
+/* Add LOD */
+int Mesh :: add_lod(int tc,int *ts,float below)
+{
+	if(lod_count >= MESH_MAX_LODS)
+		return -1;
+	lod_triangles[lod_count] = ts;
+	lod_counts[lod_count] = tc;
+	lod_below[lod_count] = below;
+	return lod_count++;
+}
+
+/* Release contents */
+void Mesh :: unload()
+{
+	/* Unmap file */
+	if(map)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(map);
+#else
+		munmap(map,map_size);
+#endif
+	}
+	map = 0;
+	map_size = 0;
+	/* Empty */
+	flags = 0;
+	point_count = 0;
+	triangle_count = 0;
+	points = 0;
+	packed = 0;
+	coords = 0;
+	colors = 0;
+	triangles = 0;
+	scale[0] = scale[1] = scale[2] = 1.0f;
+	bias[0] = bias[1] = bias[2] = 0.0f;
+	center[0] = center[1] = center[2] = 0.0f;
+	radius = 0.0f;
+	box_min[0] = box_min[1] = box_min[2] = 0.0f;
+	box_max[0] = box_max[1] = box_max[2] = 0.0f;
+	lod_count = 1;
+	lod_triangles[0] = 0;
+	lod_counts[0] = 0;
+	lod_below[0] = 0.0f;
+}
+
+/* Find bounding volumes */
+void Mesh :: bound()
+{
+	float d,r,*p;
+	int i,j;
+	/* Box */
+	for(i = 0;i < point_count;i++)
+	{
+		p = &points[i*3];
+		for(j = 0;j < 3;j++)
+		{
+			if(i == 0 || p[j] < box_min[j]) box_min[j] = p[j];
+			if(i == 0 || p[j] > box_max[j]) box_max[j] = p[j];
+		}
+	}
+	/* Sphere around the middle of the box */
+	r = 0.0f;
+	for(j = 0;j < 3;j++)
+		center[j] = (box_min[j]+box_max[j])*0.5f;
+	for(i = 0;i < point_count;i++)
+	{
+		p = &points[i*3];
+		d = (p[0]-center[0])*(p[0]-center[0])+(p[1]-center[1])*(p[1]-center[1])+(p[2]-center[2])*(p[2]-center[2]);
+		if(d > r)
+			r = d;
+	}
+	radius = (float)sqrt(r);
+}
+
+/* Write mesh file */
+int Mesh :: save(const char *path,int f)
+{
+	MeshHeader h;
+	FILE *file;
+	char *out;
+	float lo[3],hi[3],p[3];
+	short *q;
+	float *fp;
+	int i,j,ps,ok;
+	/* Find point range */
+	for(i = 0;i < point_count;i++)
+	{
+		for(j = 0;j < 3;j++)
+		{
+			if(packed)
+				p[j] = ((float)packed[i*3+j])*scale[j]+bias[j];
+			else
+				p[j] = points[i*3+j];
+			if(i == 0 || p[j] < lo[j]) lo[j] = p[j];
+			if(i == 0 || p[j] > hi[j]) hi[j] = p[j];
+		}
+	}
+	/* Lay out header and streams */
+	memset(&h,0,sizeof(h));
+	h.magic = MESH_MAGIC;
+	h.version = MESH_VERSION;
+	h.flags = f&MESH_QUANTIZED;
+	h.point_count = point_count;
+	h.triangle_count = triangle_count;
+	memcpy(h.center,center,sizeof(center));
+	h.radius = radius;
+	memcpy(h.box_min,box_min,sizeof(box_min));
+	memcpy(h.box_max,box_max,sizeof(box_max));
+	if(h.flags&MESH_QUANTIZED)
+		ps = point_count*3*sizeof(short);
+	else
+		ps = point_count*3*sizeof(float);
+	h.points = mesh_align(sizeof(MeshHeader));
+	h.coords = mesh_align(h.points+ps);
+	h.colors = mesh_align(h.coords+point_count*2*sizeof(int));
+	h.triangles = mesh_align(h.colors+point_count*sizeof(int));
+	h.size = mesh_align(h.triangles+triangle_count*3*sizeof(int));
+	h.lod_count = lod_count;
+	h.lod_triangles[0] = h.triangles;
+	h.lod_counts[0] = triangle_count;
+	for(i = 1;i < lod_count;i++)
+	{
+		h.lod_triangles[i] = h.size;
+		h.lod_counts[i] = lod_counts[i];
+		h.lod_below[i] = lod_below[i];
+		h.size = mesh_align(h.size+lod_counts[i]*3*sizeof(int));
+	}
+	for(j = 0;j < 3;j++)
+	{
+		h.scale[j] = 1.0f;
+		h.bias[j] = 0.0f;
+		if(point_count > 0 && (h.flags&MESH_QUANTIZED))
+		{
+			/* Centre the range on zero and spread it over the signed 16-bit range */
+			h.bias[j] = (lo[j]+hi[j])*0.5f;
+			if(hi[j] > lo[j])
+				h.scale[j] = (hi[j]-lo[j])/65534.0f;
+		}
+	}
+	/* Build the image */
+	out = new char[h.size];
+	memset(out,0,h.size);
+	memcpy(out,&h,sizeof(h));
+	q = (short*)(out+h.points);
+	fp = (float*)(out+h.points);
+	for(i = 0;i < point_count;i++)
+	{
+		for(j = 0;j < 3;j++)
+		{
+			if(packed)
+				p[j] = ((float)packed[i*3+j])*scale[j]+bias[j];
+			else
+				p[j] = points[i*3+j];
+			if(h.flags&MESH_QUANTIZED)
+			{
+				p[j] = (p[j]-h.bias[j])/h.scale[j];
+				p[j] += (p[j] < 0.0f) ? -0.5f : 0.5f;
+				if(p[j] > 32767.0f) p[j] = 32767.0f;
+				if(p[j] < -32767.0f) p[j] = -32767.0f;
+				q[i*3+j] = (short)p[j];
+			}
+			else
+				fp[i*3+j] = p[j];
+		}
+	}
+	if(point_count > 0)
+	{
+		memcpy(out+h.coords,coords,point_count*2*sizeof(int));
+		memcpy(out+h.colors,colors,point_count*sizeof(int));
+	}
+	if(triangle_count > 0)
+		memcpy(out+h.triangles,triangles,triangle_count*3*sizeof(int));
+	for(i = 1;i < lod_count;i++)
+	{
+		if(lod_counts[i] > 0)
+			memcpy(out+h.lod_triangles[i],lod_triangles[i],lod_counts[i]*3*sizeof(int));
+	}
+	/* Write it */
+	ok = 0;
+	file = fopen(path,"wb");
+	if(file)
+	{
+		ok = (fwrite(out,1,h.size,file) == (size_t)h.size);
+		if(fclose(file))
+			ok = 0;
+	}
+	delete[] out;
+	if(!ok)
+		return MESH_WRITE_FAILURE;
+	return 0;
+}
+
+/* Fault in pages */
+void Mesh :: prefault()
+{
+	volatile char *p;
+	int i,sum;
+	if(!map)
+		return;
+	p = (volatile char*)map;
+	sum = 0;
+	for(i = 0;i < map_size;i += 4096)
+		sum += p[i];
+	(void)sum;
+}
+
+/* Pick LOD */
+int Mesh :: select_lod(int current)
+{
+	float size;
+	int l;
+	if(lod_count <= 1)
+		return 0;
+	size = Geo::screen_size(center,radius);
+	/* Without a previous LOD just take the one the size falls in */
+	if(current < 0 || current >= lod_count)
+	{
+		for(l = 0;l+1 < lod_count && size < lod_below[l+1];l++);
+		return l;
+	}
+	/* Otherwise only move once well past a switch size */
+	l = current;
+	while(l+1 < lod_count && size < lod_below[l+1]*(1.0f-MESH_LOD_HYSTERESIS))
+		l++;
+	while(l > 0 && size >= lod_below[l]*(1.0f+MESH_LOD_HYSTERESIS))
+		l--;
+	return l;
+}
+
+/* Draw mesh */
+void Mesh :: draw()
+{
+	draw_lod(0);
+}
+
+/* Draw mesh with LOD of an instance */
+void Mesh :: draw_lod(int *lod)
+{
+	int l;
+	if(!point_count)
+		return;
+	/* Skip it when off screen or hidden behind occluders */
+	if(Geo::cull_sphere(center,radius) || Geo::cull_box(box_min,box_max) || Occlusion::test_box(box_min,box_max))
+	{
+		Geo::count_culled(1,point_count);
+		return;
+	}
+	/* Level of detail */
+	l = select_lod(lod ? *lod : -1);
+	if(lod)
+		*lod = l;
+	if(packed)
+		Geo::draw_quantized(point_count,packed,scale,bias,coords,colors,lod_counts[l],lod_triangles[l]);
+	else
+		Geo::draw(point_count,points,coords,colors,lod_counts[l],lod_triangles[l]);
+}
+
+/* Draw as occluder */
+void Mesh :: occlude()
+{
+	float *fs;
+	int i,mark;
+	if(!point_count || Geo::cull_box(box_min,box_max))
+		return;
+	if(!packed)
+	{
+		Occlusion::occluder(point_count,points,triangle_count,triangles);
+		return;
+	}
+	/* Occluders are rare, so quantized points are simply expanded in the frame arena */
+	mark = Video::get_arena()->get_mark();
+	fs = (float*)Video::frame_alloc(sizeof(float)*3*point_count);
+	if(fs)
+	{
+		for(i = 0;i < point_count*3;i++)
+			fs[i] = ((float)packed[i])*scale[i%3]+bias[i%3];
+		Occlusion::occluder(point_count,fs,triangle_count,triangles);
+	}
+	Video::get_arena()->rewind(mark);
+}
+
+/* Get point count */
+int Mesh :: get_point_count()
+{
+	return point_count;
+}
+
+/* Get triangle count */
+int Mesh :: get_triangle_count()
+{
+	return triangle_count;
+}
+
+/* Get LOD count */
+int Mesh :: get_lod_count()
+{
+	return lod_count;
+}
+
+/* Get triangle count of LOD */
+int Mesh :: get_lod_triangle_count(int l)
+{
+	if(l < 0 || l >= lod_count)
+		return 0;
+	return lod_counts[l];
+}
+
+/* Get flags */
+int Mesh :: get_flags()
+{
+	return flags;
+}
+
+/* Get bounding sphere */
+void Mesh :: get_sphere(float *c,float *r)
+{
+	memcpy(c,center,sizeof(center));
+	r[0] = radius;
+}
+
+/* Get bounding box */
+void Mesh :: get_box(float *lo,float *hi)
+{
+	memcpy(lo,box_min,sizeof(box_min));
+	memcpy(hi,box_max,sizeof(box_max));
+}
\ No newline at end of file
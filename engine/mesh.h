@@ -0,0 +1,178 @@
+#ifndef MESH_H
+#define MESH_H
+
+/* Mesh file identity */
+#define MESH_MAGIC 0x48534D44 /* "DMSH" in file byte order */
+#define MESH_VERSION 3
+#define MESH_ALIGN 16 /* Every stream in a mesh file starts on this boundary */
+#define MESH_MAX_LODS 4 /* Most levels of detail in one mesh (including the full one) */
+#define MESH_LOD_HYSTERESIS 0.15f /* How far past a switch size a mesh must go before its LOD changes back */
+
+/* Mesh flags */
+#define MESH_QUANTIZED 1 /* Points are stored as 16-bit integers with a scale and bias */
+
+/* Error codes */
+#define MESH_OPEN_FAILURE -1
+#define MESH_MAP_FAILURE -2
+#define MESH_FORMAT_FAILURE -3
+#define MESH_WRITE_FAILURE -4
+
+/* REMARKS: */
+/*
+	A mesh file is a MeshHeader followed by the point, texture coordinate, color and triangle streams,
+	each one aligned to MESH_ALIGN and laid out exactly as Geo::draw expects them.
+	Loading only maps the file and checks the header, so no stream is ever parsed or copied,
+	the first draw simply pages the data in.
+	Bounding volumes are stored in the header so culling never has to look at the points.
+	Levels of detail share the points and only have their own triangle lists, one stream each.
+	LOD 0 is the full mesh, each later LOD is used once the mesh is smaller on screen than its switch size
+	(the height of the bounding sphere in pixels). An instance that remembers its LOD only switches
+	once it goes MESH_LOD_HYSTERESIS beyond a switch size, so it does not flicker at the boundary.
+	Files are stored in native (little endian) byte order.
+*/
+
+/* Mesh file header */
+typedef struct
+{
+	int magic; /* Must be MESH_MAGIC */
+	int version; /* Must be MESH_VERSION */
+	int flags; /* Mesh flags */
+	int size; /* Size of the whole file (in bytes) */
+	int point_count; /* Count of points */
+	int triangle_count; /* Count of triangles */
+	int points; /* Offset of points (3 floats, or 3 shorts when quantized) */
+	int coords; /* Offset of texture coordinates (2 ints per point) */
+	int colors; /* Offset of colors (1 int per point) */
+	int triangles; /* Offset of triangles (3 ints per triangle) */
+	float scale[3]; /* Dequantization scale */
+	float bias[3]; /* Dequantization bias */
+	float center[3]; /* Bounding sphere */
+	float radius;
+	float box_min[3]; /* Bounding box */
+	float box_max[3];
+	int lod_count; /* Count of LODs (1 to MESH_MAX_LODS) */
+	int lod_triangles[MESH_MAX_LODS]; /* Offset of triangles of each LOD (LOD 0 is triangles) */
+	int lod_counts[MESH_MAX_LODS]; /* Count of triangles of each LOD */
+	float lod_below[MESH_MAX_LODS]; /* Screen size (in pixels) below which each LOD is used */
+}MeshHeader;
+
+/* Mesh */
+class Mesh
+{
+private:
+	void *map; /* Mapped file (0 if the mesh is not loaded from a file) */
+	int map_size; /* Size of mapped file (in bytes) */
+	int flags; /* Mesh flags */
+	int point_count; /* Count of points */
+	int triangle_count; /* Count of triangles */
+	float *points; /* Points (when not quantized) */
+	short *packed; /* Points (when quantized) */
+	int *coords; /* Texture coordinates */
+	int *colors; /* Colors */
+	int *triangles; /* Triangles */
+	float scale[3]; /* Dequantization scale */
+	float bias[3]; /* Dequantization bias */
+	float center[3]; /* Bounding sphere */
+	float radius;
+	float box_min[3]; /* Bounding box */
+	float box_max[3];
+	int lod_count; /* Count of LODs */
+	int *lod_triangles[MESH_MAX_LODS]; /* Triangles of each LOD (LOD 0 is triangles) */
+	int lod_counts[MESH_MAX_LODS]; /* Count of triangles of each LOD */
+	float lod_below[MESH_MAX_LODS]; /* Screen size (in pixels) below which each LOD is used */
+	/*
+		Finds bounding volumes from the points
+	*/
+	void bound();
+public:
+	/*
+		Creates a new empty mesh
+	*/
+	Mesh();
+	~Mesh();
+	/*
+		Maps a mesh file into memory, replacing current contents
+		Returns result code
+		path - the file to load
+	*/
+	int load(const char *path);
+	/*
+		Uses the given arrays as mesh contents, they are not copied and must outlive the mesh
+		pc - count of points
+		ps - the points
+		txs - the texture coordinates
+		cs - the colors
+		tc - count of triangles
+		ts - the triangles
+	*/
+	void set(int pc,float *ps,int *txs,int *cs,int tc,int *ts);
+	/*
+		Adds a level of detail after the last one, using the mesh points with fewer triangles
+		The triangles are not copied and must outlive the mesh
+		Returns the new LOD or -1 if there is no room
+		tc - count of triangles
+		ts - the triangles
+		below - screen size (in pixels) below which it is used, smaller than that of the LOD before
+	*/
+	int add_lod(int tc,int *ts,float below);
+	/*
+		Releases current contents, leaving an empty mesh
+	*/
+	void unload();
+	/*
+		Writes the mesh contents to a mesh file
+		Returns result code
+		path - the file to write
+		f - mesh flags to store it with (MESH_QUANTIZED to quantize points)
+	*/
+	int save(const char *path,int f);
+	/*
+		Reads every page of a mapped mesh so later draws do not fault
+		Meant to be called off the main thread
+	*/
+	void prefault();
+	/*
+		Draws the mesh with the current Geo transform, texture and mode
+		Nothing is transformed when the bounding volumes are outside the view or hidden by occluders
+	*/
+	void draw();
+	/*
+		Draws the mesh like draw, remembering the LOD of one instance
+		lod - LOD the instance was drawn with last time, updated with the one drawn now
+	*/
+	void draw_lod(int *lod);
+	/*
+		Picks the LOD for the current Geo transform and camera
+		Returns the LOD
+		current - LOD drawn last time (-1 to pick without hysteresis)
+	*/
+	int select_lod(int current);
+	/*
+		Draws the mesh into the occlusion depth buffer with the current Geo transform
+	*/
+	void occlude();
+	/*
+		Gets mesh counts
+	*/
+	int get_point_count();
+	int get_triangle_count();
+	int get_lod_count();
+	int get_lod_triangle_count(int l);
+	/*
+		Gets mesh flags
+	*/
+	int get_flags();
+	/*
+		Gets the bounding sphere
+		c - output center (3 floats)
+		r - output radius
+	*/
+	void get_sphere(float *c,float *r);
+	/*
+		Gets the bounding box
+		lo,hi - output corners (3 floats each)
+	*/
+	void get_box(float *lo,float *hi);
+};
+
+#endif
\ No newline at end of file
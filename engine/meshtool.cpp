@@ -0,0 +1,396 @@
+/*
+	Diorama Mesh Tool
+	Converts Wavefront OBJ files into mesh files, with levels of detail made by collapsing edges
+	Usage: meshtool input.obj output.dmsh [-q] [-l lods] [-s size] [-t texels]
+		-q - quantize points to 16-bit integers
+		-l - count of levels of detail, including the full mesh (1 to MESH_MAX_LODS, default 3)
+		-s - screen size (in pixels) below which the first reduced LOD is used, halved for each after it (default 64)
+		-t - texture size that texture coordinates are scaled to (default 256)
+*/
+
+/* Includes */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mesh.h"
+#include "draw.h"
+
+/* Defines */
+#define TOOL_LINE 1024 /* Longest OBJ line */
+
+/* Growing arrays */
+void tool_grow(void **data,int count,int *capacity,int size)
+{
+	char *bigger;
+	if(count < *capacity)
+		return;
+	*capacity = (*capacity) ? (*capacity)*2 : 256;
+	bigger = new char[(*capacity)*size];
+	if(count)
+		memcpy(bigger,*data,count*size);
+	if(*data)
+		delete[] (char*)*data;
+	*data = bigger;
+}
+void tool_push_float(float **data,int *count,int *capacity,float value)
+{
+	tool_grow((void**)data,*count,capacity,sizeof(float));
+	(*data)[(*count)++] = value;
+}
+void tool_push_int(int **data,int *count,int *capacity,int value)
+{
+	tool_grow((void**)data,*count,capacity,sizeof(int));
+	(*data)[(*count)++] = value;
+}
+
+/* OBJ contents */
+float *obj_positions = 0; /* 3 floats each */
+int obj_position_count = 0,obj_position_capacity = 0;
+float *obj_coords = 0; /* 2 floats each */
+int obj_coord_count = 0,obj_coord_capacity = 0;
+int *obj_corners = 0; /* Positions then coordinates (-1 for none) of the corners of each triangle */
+int obj_corner_count = 0,obj_corner_capacity = 0;
+
+/* Turns an OBJ index (1 based, or negative from the end) into a 0 based one */
+int tool_index(int i,int count)
+{
+	if(i < 0)
+		return count+i;
+	return i-1;
+}
+
+/* Reads an OBJ file */
+int tool_read(const char *path)
+{
+	char line[TOOL_LINE],*token,*slash;
+	int face[64][2],n,i,j;
+	float x,y,z;
+	FILE *file;
+	file = fopen(path,"r");
+	if(!file)
+		return 0;
+	while(fgets(line,sizeof(line),file))
+	{
+		if(line[0] == 'v' && line[1] == ' ')
+		{
+			x = y = z = 0.0f;
+			sscanf(line+2,"%f %f %f",&x,&y,&z);
+			tool_push_float(&obj_positions,&obj_position_count,&obj_position_capacity,x);
+			tool_push_float(&obj_positions,&obj_position_count,&obj_position_capacity,y);
+			tool_push_float(&obj_positions,&obj_position_count,&obj_position_capacity,z);
+		}
+		else if(line[0] == 'v' && line[1] == 't')
+		{
+			x = y = 0.0f;
+			sscanf(line+3,"%f %f",&x,&y);
+			tool_push_float(&obj_coords,&obj_coord_count,&obj_coord_capacity,x);
+			tool_push_float(&obj_coords,&obj_coord_count,&obj_coord_capacity,y);
+		}
+		else if(line[0] == 'f' && line[1] == ' ')
+		{
+			/* Corners are v, v/vt, v/vt/vn or v//vn */
+			n = 0;
+			for(token = strtok(line+2," \t\r\n");token && n < 64;token = strtok(0," \t\r\n"))
+			{
+				face[n][0] = tool_index(atoi(token),obj_position_count/3);
+				face[n][1] = -1;
+				slash = strchr(token,'/');
+				if(slash && slash[1] != '/' && slash[1])
+					face[n][1] = tool_index(atoi(slash+1),obj_coord_count/2);
+				if(face[n][0] < 0 || face[n][0] >= obj_position_count/3)
+					continue;
+				if(face[n][1] >= obj_coord_count/2)
+					face[n][1] = -1;
+				n++;
+			}
+			/* Fan into triangles, stored as 3 positions then 3 coordinates */
+			for(i = 2;i < n;i++)
+			{
+				for(j = 0;j < 2;j++)
+				{
+					tool_push_int(&obj_corners,&obj_corner_count,&obj_corner_capacity,face[0][j]);
+					tool_push_int(&obj_corners,&obj_corner_count,&obj_corner_capacity,face[i-1][j]);
+					tool_push_int(&obj_corners,&obj_corner_count,&obj_corner_capacity,face[i][j]);
+				}
+			}
+		}
+	}
+	fclose(file);
+	return 1;
+}
+
+/* Mesh being built */
+float *mesh_points = 0;
+int *mesh_coords = 0;
+int *mesh_colors = 0;
+int *mesh_positions = 0; /* OBJ position of each point, points sharing one sit on a seam */
+int mesh_point_count = 0;
+int *mesh_triangles = 0;
+int mesh_triangle_count = 0;
+
+/* Turns OBJ corners into points shared between triangles where position and coordinate match */
+void tool_weld(int texels)
+{
+	int *table,size,i,j,h,p,c,u,v,corner;
+	size = 1;
+	while(size < obj_corner_count)
+		size <<= 1;
+	size <<= 1;
+	table = new int[size];
+	for(i = 0;i < size;i++)
+		table[i] = -1;
+	mesh_triangle_count = obj_corner_count/6;
+	mesh_triangles = new int[mesh_triangle_count*3];
+	mesh_points = new float[obj_corner_count/2*3];
+	mesh_coords = new int[obj_corner_count/2*2];
+	mesh_colors = new int[obj_corner_count/2];
+	mesh_positions = new int[obj_corner_count/2];
+	for(i = 0;i < mesh_triangle_count;i++)
+	{
+		for(j = 0;j < 3;j++)
+		{
+			/* OBJ coordinates grow upwards, texture rows grow downwards */
+			p = obj_corners[i*6+j];
+			c = obj_corners[i*6+3+j];
+			u = 0;
+			v = 0;
+			if(c >= 0)
+			{
+				u = (int)(obj_coords[c*2]*texels);
+				v = (int)((1.0f-obj_coords[c*2+1])*texels);
+			}
+			/* Look the pair up */
+			h = ((p*73856093)^(u*19349663)^(v*83492791))&(size-1);
+			for(;table[h] >= 0;h = (h+1)&(size-1))
+			{
+				corner = table[h];
+				if(mesh_positions[corner] == p && mesh_coords[corner*2] == u && mesh_coords[corner*2+1] == v)
+					break;
+			}
+			if(table[h] < 0)
+			{
+				/* New point */
+				corner = mesh_point_count++;
+				table[h] = corner;
+				mesh_positions[corner] = p;
+				memcpy(&mesh_points[corner*3],&obj_positions[p*3],sizeof(float)*3);
+				mesh_coords[corner*2] = u;
+				mesh_coords[corner*2+1] = v;
+				mesh_colors[corner] = DRAW_WHITE;
+			}
+			mesh_triangles[i*3+j] = table[h];
+		}
+	}
+	delete[] table;
+}
+
+/* Edge between two points */
+typedef struct
+{
+	int a,b; /* Points (a < b) */
+	float length; /* Squared length */
+}ToolEdge;
+
+/* Orders edges by their points */
+int tool_by_points(const void *x,const void *y)
+{
+	const ToolEdge *a = (const ToolEdge*)x,*b = (const ToolEdge*)y;
+	if(a->a != b->a)
+		return a->a-b->a;
+	return a->b-b->b;
+}
+
+/* Orders edges by length */
+int tool_by_length(const void *x,const void *y)
+{
+	const ToolEdge *a = (const ToolEdge*)x,*b = (const ToolEdge*)y;
+	if(a->length < b->length)
+		return -1;
+	return a->length > b->length;
+}
+
+/* Follows collapsed points to the one that is left */
+int tool_find(int *remap,int p)
+{
+	while(remap[p] != p)
+	{
+		remap[p] = remap[remap[p]];
+		p = remap[p];
+	}
+	return p;
+}
+
+/* Collapses short edges until the triangle count drops to the target */
+/* Returns the triangle count of the result */
+int tool_simplify(int *ts,int tc,int target,int *out)
+{
+	ToolEdge *edges;
+	int *remap,*fixed,*touched,*shared;
+	int ec,i,j,k,a,b,t,collapsed,want;
+	float dx,dy,dz;
+	memcpy(out,ts,sizeof(int)*tc*3);
+	remap = new int[mesh_point_count];
+	fixed = new int[mesh_point_count];
+	touched = new int[mesh_point_count];
+	shared = new int[obj_position_count/3];
+	edges = new ToolEdge[tc*3];
+	for(i = 0;i < mesh_point_count;i++)
+		remap[i] = i;
+	/* Points on texture seams cannot move without opening cracks */
+	for(i = 0;i < obj_position_count/3;i++)
+		shared[i] = 0;
+	for(i = 0;i < mesh_point_count;i++)
+		shared[mesh_positions[i]]++;
+	while(tc > target)
+	{
+		/* Gather edges */
+		ec = 0;
+		for(i = 0;i < tc;i++)
+		{
+			for(j = 0;j < 3;j++)
+			{
+				a = out[i*3+j];
+				b = out[i*3+(j+1)%3];
+				if(a > b)
+				{
+					t = a;
+					a = b;
+					b = t;
+				}
+				dx = mesh_points[a*3]-mesh_points[b*3];
+				dy = mesh_points[a*3+1]-mesh_points[b*3+1];
+				dz = mesh_points[a*3+2]-mesh_points[b*3+2];
+				edges[ec].a = a;
+				edges[ec].b = b;
+				edges[ec].length = dx*dx+dy*dy+dz*dz;
+				ec++;
+			}
+		}
+		/* Points on open borders cannot move either (an edge used once is a border) */
+		for(i = 0;i < mesh_point_count;i++)
+		{
+			fixed[i] = (shared[mesh_positions[i]] > 1);
+			touched[i] = 0;
+		}
+		qsort(edges,ec,sizeof(ToolEdge),tool_by_points);
+		for(i = 0;i < ec;i = j)
+		{
+			for(j = i+1;j < ec && edges[j].a == edges[i].a && edges[j].b == edges[i].b;j++);
+			if(j-i == 1)
+			{
+				fixed[edges[i].a] = 1;
+				fixed[edges[i].b] = 1;
+			}
+		}
+		/* Collapse shortest edges first, each point at most once per pass */
+		qsort(edges,ec,sizeof(ToolEdge),tool_by_length);
+		collapsed = 0;
+		want = (tc-target+1)/2;
+		for(i = 0;i < ec && collapsed < want;i++)
+		{
+			a = edges[i].a;
+			b = edges[i].b;
+			if(touched[a] || touched[b])
+				continue;
+			/* Move the free end onto the other */
+			if(fixed[b])
+			{
+				t = a;
+				a = b;
+				b = t;
+			}
+			if(fixed[b])
+				continue;
+			remap[b] = a;
+			touched[a] = 1;
+			touched[b] = 1;
+			collapsed++;
+		}
+		if(!collapsed)
+			break;
+		/* Rebuild triangles, dropping the ones that collapsed */
+		k = 0;
+		for(i = 0;i < tc;i++)
+		{
+			a = tool_find(remap,out[i*3]);
+			b = tool_find(remap,out[i*3+1]);
+			t = tool_find(remap,out[i*3+2]);
+			if(a == b || b == t || a == t)
+				continue;
+			out[k*3] = a;
+			out[k*3+1] = b;
+			out[k*3+2] = t;
+			k++;
+		}
+		tc = k;
+	}
+	delete[] remap;
+	delete[] fixed;
+	delete[] touched;
+	delete[] shared;
+	delete[] edges;
+	return tc;
+}
+
+/* Entry */
+int main(int argn,char **argv)
+{
+	int *lods[MESH_MAX_LODS];
+	int lod_counts[MESH_MAX_LODS];
+	int i,flags,lod_count,texels,result;
+	float size;
+	Mesh mesh;
+	if(argn < 3)
+	{
+		printf("Usage: meshtool input.obj output.dmsh [-q] [-l lods] [-s size] [-t texels]\n");
+		return -1;
+	}
+	/* Options */
+	flags = 0;
+	lod_count = 3;
+	size = 64.0f;
+	texels = 256;
+	for(i = 3;i < argn;i++)
+	{
+		if(!strcmp(argv[i],"-q"))
+			flags |= MESH_QUANTIZED;
+		else if(!strcmp(argv[i],"-l") && i+1 < argn)
+			lod_count = atoi(argv[++i]);
+		else if(!strcmp(argv[i],"-s") && i+1 < argn)
+			size = (float)atof(argv[++i]);
+		else if(!strcmp(argv[i],"-t") && i+1 < argn)
+			texels = atoi(argv[++i]);
+	}
+	if(lod_count < 1)
+		lod_count = 1;
+	if(lod_count > MESH_MAX_LODS)
+		lod_count = MESH_MAX_LODS;
+	/* Read and weld */
+	if(!tool_read(argv[1]))
+	{
+		printf("Could not read %s\n",argv[1]);
+		return -1;
+	}
+	tool_weld(texels);
+	mesh.set(mesh_point_count,mesh_points,mesh_coords,mesh_colors,mesh_triangle_count,mesh_triangles);
+	printf("LOD 0: %d points, %d triangles\n",mesh_point_count,mesh_triangle_count);
+	/* Each LOD aims for half the triangles of the one before */
+	lods[0] = mesh_triangles;
+	lod_counts[0] = mesh_triangle_count;
+	for(i = 1;i < lod_count;i++)
+	{
+		lods[i] = new int[lod_counts[i-1]*3];
+		lod_counts[i] = tool_simplify(lods[i-1],lod_counts[i-1],lod_counts[i-1]/2,lods[i]);
+		mesh.add_lod(lod_counts[i],lods[i],size);
+		printf("LOD %d: %d triangles below %.1f pixels\n",i,lod_counts[i],size);
+		size *= 0.5f;
+	}
+	/* Write */
+	result = mesh.save(argv[2],flags);
+	if(result)
+	{
+		printf("Could not write %s (%d)\n",argv[2],result);
+		return -1;
+	}
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,230 @@
+/*
+	Morph - Vertex animation from quantized frames
+*/
+
+/* Includes */
+#include <math.h>
+#include <memory.h>
+#include <emmintrin.h>
+#include "morph.h"
+
+/* Converts twelve 8-bit deltas to floats */
+static inline void morph_expand8(unsigned char *p,__m128 *f)
+{
+	__m128i v,lo,hi;
+	v = _mm_loadu_si128((__m128i*)p);
+	/* Sign extend by duplicating each byte and shifting back down */
+	lo = _mm_srai_epi16(_mm_unpacklo_epi8(v,v),8);
+	hi = _mm_srai_epi16(_mm_unpackhi_epi8(v,v),8);
+	f[0] = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(lo,lo),16));
+	f[1] = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(lo,lo),16));
+	f[2] = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(hi,hi),16));
+}
+
+/* Converts twelve 16-bit deltas to floats */
+static inline void morph_expand16(unsigned char *p,__m128 *f)
+{
+	__m128i lo,hi;
+	lo = _mm_loadu_si128((__m128i*)p);
+	hi = _mm_loadu_si128((__m128i*)(p+16));
+	f[0] = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(lo,lo),16));
+	f[1] = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(lo,lo),16));
+	f[2] = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(hi,hi),16));
+}
+
+/* Reads one delta */
+static inline float morph_delta(unsigned char *p,int bits,int i)
+{
+	if(bits == 8)
+		return (float)((signed char*)p)[i];
+	return (float)((short*)p)[i];
+}
+
+/* New morph */
+Morph :: Morph(int pc,int fc,int b)
+{
+	if(pc < 0)
+		pc = 0;
+	if(fc < 1)
+		fc = 1;
+	point_count = pc;
+	frame_count = 0;
+	frame_capacity = fc;
+	bits = (b == 8) ? 8 : 16;
+	base = new float[pc*3];
+	deltas = new unsigned char[pc*3*(bits/8)*fc+MORPH_PAD];
+	scales = new float[fc*3];
+	biases = new float[fc*3];
+	blended = new float[pc*3];
+	memset(base,0,sizeof(float)*pc*3);
+	memset(deltas,0,pc*3*(bits/8)*fc+MORPH_PAD);
+	memset(blended,0,sizeof(float)*pc*3);
+}
+
+/* Delete morph */
+Morph :: ~Morph()
+{
+	delete[] base;
+	delete[] deltas;
+	delete[] scales;
+	delete[] biases;
+	delete[] blended;
+}
+
+/* Add frame */
+int Morph :: add_frame(float *ps)
+{
+	float lo[3],hi[3],d,s,*scale,*bias;
+	int i,a,q,least,most;
+	unsigned char *out;
+	if(frame_count >= frame_capacity)
+		return MORPH_ERROR_FULL;
+	/* The first frame is the base */
+	if(!frame_count)
+	{
+		memcpy(base,ps,sizeof(float)*point_count*3);
+		memcpy(blended,ps,sizeof(float)*point_count*3);
+	}
+	/* Range of the deltas on each axis */
+	for(a = 0;a < 3;a++)
+	{
+		lo[a] = 0.0f;
+		hi[a] = 0.0f;
+	}
+	for(i = 0;i < point_count*3;i++)
+	{
+		d = ps[i]-base[i];
+		if(d < lo[i%3])
+			lo[i%3] = d;
+		if(d > hi[i%3])
+			hi[i%3] = d;
+	}
+	/* Spread the range over every integer */
+	least = -(1<<(bits-1));
+	most = (1<<(bits-1))-1;
+	scale = &scales[frame_count*3];
+	bias = &biases[frame_count*3];
+	for(a = 0;a < 3;a++)
+	{
+		scale[a] = (hi[a]-lo[a])/(float)(most-least);
+		bias[a] = lo[a]-(float)least*scale[a];
+	}
+	/* Quantize */
+	out = &deltas[frame_count*point_count*3*(bits/8)];
+	for(i = 0;i < point_count*3;i++)
+	{
+		s = scale[i%3];
+		q = least;
+		if(s > 0.0f)
+			q = (int)floorf((ps[i]-base[i]-lo[i%3])/s+0.5f)+least;
+		if(q < least)
+			q = least;
+		if(q > most)
+			q = most;
+		if(bits == 8)
+			((signed char*)out)[i] = (signed char)q;
+		else
+			((short*)out)[i] = (short)q;
+	}
+	return frame_count++;
+}
+
+/* Blend frames */
+void Morph :: blend(int a,int b,float w)
+{
+	float ka[3],kb[3],kc[3],*pb,*po;
+	__m128 ca[3],cb[3],cc[3],fa[3],fb[3];
+	unsigned char *da,*db;
+	int i,j,size;
+	if(a < 0 || a >= frame_count || b < 0 || b >= frame_count)
+		return;
+	/* Fold weights and dequantization into one multiplier per frame and axis, and one offset */
+	for(j = 0;j < 3;j++)
+	{
+		ka[j] = scales[a*3+j]*(1.0f-w);
+		kb[j] = scales[b*3+j]*w;
+		kc[j] = biases[a*3+j]*(1.0f-w)+biases[b*3+j]*w;
+	}
+	/* Four points are twelve floats, so the axes line up again every three registers */
+	for(j = 0;j < 3;j++)
+	{
+		ca[j] = _mm_set_ps(ka[(j+3)%3],ka[(j+2)%3],ka[(j+1)%3],ka[j]);
+		cb[j] = _mm_set_ps(kb[(j+3)%3],kb[(j+2)%3],kb[(j+1)%3],kb[j]);
+		cc[j] = _mm_set_ps(kc[(j+3)%3],kc[(j+2)%3],kc[(j+1)%3],kc[j]);
+	}
+	size = bits/8;
+	da = &deltas[a*point_count*3*size];
+	db = &deltas[b*point_count*3*size];
+	for(i = 0;i+4 <= point_count;i += 4)
+	{
+		if(bits == 8)
+		{
+			morph_expand8(&da[i*3],fa);
+			morph_expand8(&db[i*3],fb);
+		}
+		else
+		{
+			morph_expand16(&da[i*6],fa);
+			morph_expand16(&db[i*6],fb);
+		}
+		pb = &base[i*3];
+		po = &blended[i*3];
+		for(j = 0;j < 3;j++)
+			_mm_storeu_ps(&po[j*4],_mm_add_ps(_mm_add_ps(_mm_loadu_ps(&pb[j*4]),cc[j]),_mm_add_ps(_mm_mul_ps(fa[j],ca[j]),_mm_mul_ps(fb[j],cb[j]))));
+	}
+	/* Leftovers one by one */
+	for(i *= 3;i < point_count*3;i++)
+		blended[i] = base[i]+kc[i%3]+morph_delta(da,bits,i)*ka[i%3]+morph_delta(db,bits,i)*kb[i%3];
+}
+
+/* Sample at a frame position */
+void Morph :: sample(float f,int loop)
+{
+	int a,b;
+	if(!frame_count)
+		return;
+	if(loop)
+	{
+		f = fmodf(f,(float)frame_count);
+		if(f < 0.0f)
+			f += (float)frame_count;
+	}
+	else
+	{
+		if(f < 0.0f)
+			f = 0.0f;
+		if(f > (float)(frame_count-1))
+			f = (float)(frame_count-1);
+	}
+	a = (int)f;
+	if(a >= frame_count)
+		a = frame_count-1;
+	b = a+1;
+	if(b >= frame_count)
+		b = loop ? 0 : a;
+	blend(a,b,f-(float)a);
+}
+
+/* Get blended points */
+float *Morph :: get_points()
+{
+	return blended;
+}
+
+/* Get point count */
+int Morph :: get_point_count()
+{
+	return point_count;
+}
+
+/* Get frame count */
+int Morph :: get_frame_count()
+{
+	return frame_count;
+}
+
+/* Get size */
+int Morph :: get_size()
+{
+	return point_count*3*(int)sizeof(float)+frame_count*(point_count*3*(bits/8)+6*(int)sizeof(float));
+}
\ No newline at end of file
@@ -0,0 +1,71 @@
+#ifndef MORPH_H
+#define MORPH_H
+
+/* Defines */
+#define MORPH_PAD 16 /* Spare bytes after the deltas so SSE loads may read past the last point */
+
+/* Error codes */
+#define MORPH_ERROR_FULL -1
+
+/* REMARKS: */
+/*
+	A morph animation stores every point of every frame, like an MD2 model, for rigid-segment
+	animation that a skeleton cannot express.
+	The first frame is kept as floats and is the base, every frame (including the first) is stored as
+	deltas from it quantized to 8 or 16-bit integers, with a scale and bias per frame and axis.
+	8-bit frames take a quarter of the memory of float frames (16-bit half), quantization error is at most
+	half of the scale on each axis, so 8-bit suits small motions and 16-bit anything else.
+	Blending two frames folds both dequantizations and the blend weight into one multiply-add per delta,
+	done four points at a time with SSE, and writes points ready for Geo::draw.
+*/
+
+/* Morph */
+class Morph
+{
+private:
+	int point_count; /* Count of points */
+	int frame_count; /* Count of frames added */
+	int frame_capacity; /* Most frames */
+	int bits; /* Bits per delta (8 or 16) */
+	float *base; /* Points of the first frame */
+	unsigned char *deltas; /* Quantized deltas (3 per point, frame after frame) */
+	float *scales; /* Dequantization scale of each frame (3 floats each) */
+	float *biases; /* Dequantization bias of each frame (3 floats each) */
+	float *blended; /* Output points */
+public:
+	/*
+		Creates an empty morph animation
+		pc - count of points in each frame
+		fc - most frames
+		b - bits per delta (8 or 16)
+	*/
+	Morph(int pc,int fc,int b);
+	~Morph();
+	/*
+		Quantizes and adds a frame
+		Returns frame index or error code
+		ps - points of the frame (3 floats each)
+	*/
+	int add_frame(float *ps);
+	/*
+		Blends two frames into the output points
+		a,b - the frames
+		w - weight of b (0 to 1)
+	*/
+	void blend(int a,int b,float w);
+	/*
+		Blends the frames either side of a fractional frame position
+		f - frame position (frames from the first)
+		loop - wrap around to the first frame after the last, otherwise hold the last
+	*/
+	void sample(float f,int loop);
+	/*
+		Gets morph contents
+	*/
+	float *get_points();
+	int get_point_count();
+	int get_frame_count();
+	int get_size(); /* Bytes of frame data (base and deltas) */
+};
+
+#endif
\ No newline at end of file
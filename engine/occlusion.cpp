@@ -0,0 +1,186 @@
+/*
+	Occlusion - Coarse software depth buffer for hiding whole objects
+*/
+
+/* Includes */
+#include <memory.h>
+#include <math.h>
+#include <xmmintrin.h>
+#include "occlusion.h"
+#include "geo.h"
+#include "video.h"
+
+/* Occlusion */
+namespace Occlusion
+{
+	/* Globals */
+	float occlusion_buffer[OCCLUSION_WIDTH*OCCLUSION_HEIGHT]; /* Nearest occluder (1/w) */
+	int occlusion_active = 0; /* Anything drawn since the last clear? */
+	int occlusion_hidden = 0; /* Boxes hidden since the last clear */
+	/* Clear */
+	void clear()
+	{
+		memset(occlusion_buffer,0,sizeof(occlusion_buffer));
+		occlusion_active = 0;
+		occlusion_hidden = 0;
+	}
+	/* Places a transformed point on the buffer (x,y in pixels, then 1/w) */
+	void place(float *p,float *o)
+	{
+		float iw;
+		iw = 1.0f/p[3];
+		o[0] = (p[0]*iw*((float)Video::get_height())/((float)Video::get_width())*0.5f+0.5f)*OCCLUSION_WIDTH;
+		o[1] = (p[1]*iw*0.5f+0.5f)*OCCLUSION_HEIGHT;
+		o[2] = iw;
+	}
+	/* Rasterizes a triangle, keeping the nearest depth */
+	void raster(float *a,float *b,float *c)
+	{
+		__m128 px,py,e0,e1,e2,z,in,d;
+		float area,*t,ax,ay,bx,by,cx,cy,zx,zy,z0;
+		int x,y,xfrom,xto,yfrom,yto;
+		/* Make the edge functions positive inside */
+		area = (b[0]-a[0])*(c[1]-a[1])-(b[1]-a[1])*(c[0]-a[0]);
+		if(area == 0.0f)
+			return;
+		if(area < 0.0f)
+		{
+			t = b;
+			b = c;
+			c = t;
+			area = -area;
+		}
+		/* Bounds (on the buffer) */
+		xfrom = (int)floorf(fminf(a[0],fminf(b[0],c[0])));
+		xto = (int)floorf(fmaxf(a[0],fmaxf(b[0],c[0])));
+		yfrom = (int)floorf(fminf(a[1],fminf(b[1],c[1])));
+		yto = (int)floorf(fmaxf(a[1],fmaxf(b[1],c[1])));
+		if(xfrom < 0) xfrom = 0;
+		if(yfrom < 0) yfrom = 0;
+		if(xto > OCCLUSION_WIDTH-1) xto = OCCLUSION_WIDTH-1;
+		if(yto > OCCLUSION_HEIGHT-1) yto = OCCLUSION_HEIGHT-1;
+		if(xfrom > xto || yfrom > yto)
+			return;
+		xfrom &= ~3;
+		/* Edge function of each side is A*x+B*y+C, depth is zx*x+zy*y+z0 */
+		ax = -(c[1]-b[1]);
+		ay = c[0]-b[0];
+		bx = -(a[1]-c[1]);
+		by = a[0]-c[0];
+		cx = -(b[1]-a[1]);
+		cy = b[0]-a[0];
+		zx = (ax*a[2]+bx*b[2]+cx*c[2])/area;
+		zy = (ay*a[2]+by*b[2]+cy*c[2])/area;
+		z0 = a[2]-zx*a[0]-zy*a[1];
+		for(y = yfrom;y <= yto;y++)
+		{
+			/* Four pixel centers at a time */
+			py = _mm_set1_ps(((float)y)+0.5f);
+			for(x = xfrom;x <= xto;x += 4)
+			{
+				px = _mm_add_ps(_mm_set1_ps((float)x),_mm_set_ps(3.5f,2.5f,1.5f,0.5f));
+				e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(ax),_mm_sub_ps(px,_mm_set1_ps(b[0]))),_mm_mul_ps(_mm_set1_ps(ay),_mm_sub_ps(py,_mm_set1_ps(b[1]))));
+				e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(bx),_mm_sub_ps(px,_mm_set1_ps(c[0]))),_mm_mul_ps(_mm_set1_ps(by),_mm_sub_ps(py,_mm_set1_ps(c[1]))));
+				e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(cx),_mm_sub_ps(px,_mm_set1_ps(a[0]))),_mm_mul_ps(_mm_set1_ps(cy),_mm_sub_ps(py,_mm_set1_ps(a[1]))));
+				in = _mm_and_ps(_mm_cmpge_ps(e0,_mm_setzero_ps()),_mm_and_ps(_mm_cmpge_ps(e1,_mm_setzero_ps()),_mm_cmpge_ps(e2,_mm_setzero_ps())));
+				if(!_mm_movemask_ps(in))
+					continue;
+				/* Keep the nearer depth where inside */
+				z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(zx),px),_mm_mul_ps(_mm_set1_ps(zy),py)),_mm_set1_ps(z0));
+				z = _mm_mul_ps(z,_mm_set1_ps(OCCLUSION_BIAS));
+				d = _mm_loadu_ps(&occlusion_buffer[x+y*OCCLUSION_WIDTH]);
+				d = _mm_or_ps(_mm_and_ps(in,_mm_max_ps(d,z)),_mm_andnot_ps(in,d));
+				_mm_storeu_ps(&occlusion_buffer[x+y*OCCLUSION_WIDTH],d);
+			}
+		}
+	}
+	/* Draw occluders */
+	void occluder(int pc,float *ps,int tc,int *ts)
+	{
+		float *out,*a,*b,*c,pa[3],pb[3],pc3[3];
+		int i,mark;
+		/* Transform all points at once */
+		mark = Video::get_arena()->get_mark();
+		out = (float*)Video::frame_alloc(sizeof(float)*4*pc);
+		if(!out)
+			return;
+		Geo::get_combined()->transform_points(pc,ps,out);
+		for(i = 0;i < tc;i++)
+		{
+			a = &out[ts[i*3]*4];
+			b = &out[ts[i*3+1]*4];
+			c = &out[ts[i*3+2]*4];
+			/* Triangles reaching behind the camera are left out, that only ever hides less */
+			if(a[3] <= GEO_NEAR_W || b[3] <= GEO_NEAR_W || c[3] <= GEO_NEAR_W)
+				continue;
+			place(a,pa);
+			place(b,pb);
+			place(c,pc3);
+			raster(pa,pb,pc3);
+		}
+		Video::get_arena()->rewind(mark);
+		occlusion_active = 1;
+	}
+	/* Test box */
+	int test_box(float *lo,float *hi)
+	{
+		__m128 near,d;
+		float p[4],o[3],xmin,xmax,ymin,ymax,zmax;
+		int i,x,y,xfrom,xto,yfrom,yto;
+		if(!occlusion_active)
+			return 0;
+		/* Rectangle and nearest depth of the corners */
+		for(i = 0;i < 8;i++)
+		{
+			Vector v((i&1) ? hi[0] : lo[0],(i&2) ? hi[1] : lo[1],(i&4) ? hi[2] : lo[2],1.0f);
+			v.multiply(Geo::get_combined());
+			p[0] = v.get_x();
+			p[1] = v.get_y();
+			p[2] = v.get_z();
+			p[3] = v.get_w();
+			if(p[3] <= GEO_NEAR_W)
+				return 0;
+			place(p,o);
+			if(i == 0 || o[0] < xmin) xmin = o[0];
+			if(i == 0 || o[0] > xmax) xmax = o[0];
+			if(i == 0 || o[1] < ymin) ymin = o[1];
+			if(i == 0 || o[1] > ymax) ymax = o[1];
+			if(i == 0 || o[2] > zmax) zmax = o[2];
+		}
+		/* Grown by a pixel since occluders only cover pixel centers */
+		xfrom = (int)floorf(xmin)-1;
+		xto = (int)floorf(xmax)+1;
+		yfrom = (int)floorf(ymin)-1;
+		yto = (int)floorf(ymax)+1;
+		if(xfrom < 0) xfrom = 0;
+		if(yfrom < 0) yfrom = 0;
+		if(xto > OCCLUSION_WIDTH-1) xto = OCCLUSION_WIDTH-1;
+		if(yto > OCCLUSION_HEIGHT-1) yto = OCCLUSION_HEIGHT-1;
+		if(xfrom > xto || yfrom > yto)
+			return 0;
+		xfrom &= ~3;
+		/* Seen if any occluder depth is not nearer than the box (checking extra pixels is harmless) */
+		near = _mm_set1_ps(zmax);
+		for(y = yfrom;y <= yto;y++)
+		{
+			for(x = xfrom;x <= xto;x += 4)
+			{
+				d = _mm_loadu_ps(&occlusion_buffer[x+y*OCCLUSION_WIDTH]);
+				if(_mm_movemask_ps(_mm_cmpge_ps(near,d)))
+					return 0;
+			}
+		}
+		occlusion_hidden++;
+		return 1;
+	}
+	/* Get hidden count */
+	int get_hidden()
+	{
+		return occlusion_hidden;
+	}
+	/* Get buffer */
+	float *get_buffer()
+	{
+		return occlusion_buffer;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+/* Defines */
+#define OCCLUSION_WIDTH 80 /* Size of the depth buffer (width must be a multiple of 4) */
+#define OCCLUSION_HEIGHT 60
+#define OCCLUSION_BIAS 0.999f /* Pushes occluders back a little so they never hide themselves */
+
+/* REMARKS: */
+/*
+	Occluders (usually big simple shapes like buildings) are rasterized into a small depth buffer
+	before anything is drawn, then bounding boxes are tested against it before their meshes are.
+	The buffer holds 1/w, which is linear across the screen so it can be interpolated directly,
+	and larger means nearer. A box is hidden when its nearest corner is behind every occluder
+	over the whole rectangle it covers (grown by a pixel, since occluders are sampled at pixel centers).
+	Occlusion only works with a perspective camera, and triangles crossing the near plane
+	are left out of the buffer. The buffer is cleared at the start of every frame.
+*/
+
+/* Occlusion */
+namespace Occlusion
+{
+	/*
+		Clears the depth buffer, nothing is hidden until occluders are drawn again
+	*/
+	extern void clear();
+	/*
+		Draws occluding triangles into the depth buffer with the current Geo transform and camera
+		pc - count of points
+		ps - the points
+		tc - count of triangles
+		ts - the triangles
+	*/
+	extern void occluder(int pc,float *ps,int tc,int *ts);
+	/*
+		Tests a box in the space of the current transform against the depth buffer
+		Returns 1 if it is entirely hidden, 0 if it may be seen
+		lo,hi - corners (3 floats each)
+	*/
+	extern int test_box(float *lo,float *hi);
+	/*
+		Gets count of boxes hidden since the last clear
+	*/
+	extern int get_hidden();
+	/*
+		Gets the depth buffer (OCCLUSION_WIDTH*OCCLUSION_HEIGHT values of 1/w, 0 where empty)
+	*/
+	extern float *get_buffer();
+}
+
+#endif
\ No newline at end of file
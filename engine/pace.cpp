@@ -0,0 +1,165 @@
+/*
+	Pace - Keeps frames on time without relying on vsync
+*/
+
+/* Includes */
+#include "pace.h"
+#include "system.h"
+
+/* Pace */
+namespace Pace
+{
+	/* Globals */
+	int pace_period = 1000000/PACE_DEFAULT_FPS; /* Target frame time (microseconds, 0 for unlimited) */
+	long long pace_deadline = 0; /* When the next frame should start (0 before the first frame) */
+	int pace_spin = PACE_DEFAULT_SPIN; /* How long before a deadline we stop sleeping and spin */
+	long long pace_last = 0; /* When the last frame started */
+	int pace_frames = 0; /* Statistics */
+	long long pace_total = 0;
+	long long pace_jitter = 0;
+	int pace_minimum = 0;
+	int pace_maximum = 0;
+	int pace_previous = 0; /* Last frame time (jitter reference when unlimited) */
+	int pace_step_period = 1000000/PACE_DEFAULT_FPS; /* Fixed update length (microseconds) */
+	long long pace_step_last = 0; /* When step last looked at the clock */
+	long long pace_accum = 0; /* Time owed to fixed updates */
+	int pace_steps = 0; /* Fixed updates run so far this frame */
+	/* Set frame rate */
+	void set_target(int fps)
+	{
+		if(fps > 0)
+			pace_period = 1000000/fps;
+		else
+			pace_period = 0;
+		pace_deadline = 0;
+	}
+	/* Sleeps most of the way to the deadline, learning how late sleeps wake up */
+	void sleep_until(long long deadline)
+	{
+		long long now,woke;
+		int ms,late,want;
+		now = System::get_micro();
+		if(deadline-now <= pace_spin)
+			return;
+		/* Sleep in whole milliseconds */
+		ms = (int)((deadline-now-pace_spin)/1000);
+		if(ms <= 0)
+			return;
+		System::sleep(ms);
+		woke = System::get_micro();
+		/* Grow the margin at once when woken late, shrink it slowly when sleeps are accurate */
+		late = (int)(woke-(now+ms*1000));
+		want = late+500;
+		if(want > pace_spin)
+			pace_spin = want;
+		else
+			pace_spin -= (pace_spin-want)/16;
+		if(pace_spin > PACE_MAX_SPIN)
+			pace_spin = PACE_MAX_SPIN;
+		if(pace_spin < 500)
+			pace_spin = 500;
+	}
+	/* Wait for next frame */
+	void wait()
+	{
+		long long now;
+		int frame,off;
+		/* Hold the frame back */
+		if(pace_period > 0)
+		{
+			now = System::get_micro();
+			/* First frame, or so late that catching up makes no sense */
+			if(!pace_deadline || now > pace_deadline+pace_period)
+				pace_deadline = now;
+			sleep_until(pace_deadline);
+			while(System::get_micro() < pace_deadline);
+			pace_deadline += pace_period;
+		}
+		/* Measure */
+		now = System::get_micro();
+		if(pace_last)
+		{
+			frame = (int)(now-pace_last);
+			if(pace_period > 0)
+				off = frame-pace_period;
+			else
+				off = frame-pace_previous;
+			if(off < 0)
+				off = -off;
+			if(!pace_frames || frame < pace_minimum)
+				pace_minimum = frame;
+			if(!pace_frames || frame > pace_maximum)
+				pace_maximum = frame;
+			pace_frames++;
+			pace_total += frame;
+			pace_jitter += off;
+			pace_previous = frame;
+		}
+		pace_last = now;
+	}
+	/* Get statistics */
+	void get_stats(PaceStats *s)
+	{
+		s->frames = pace_frames;
+		s->minimum = pace_minimum;
+		s->maximum = pace_maximum;
+		s->average = 0;
+		s->jitter = 0;
+		if(pace_frames)
+		{
+			s->average = (int)(pace_total/pace_frames);
+			s->jitter = (int)(pace_jitter/pace_frames);
+		}
+	}
+	/* Reset statistics */
+	void reset_stats()
+	{
+		pace_frames = 0;
+		pace_total = 0;
+		pace_jitter = 0;
+		pace_minimum = 0;
+		pace_maximum = 0;
+	}
+	/* Set update rate */
+	void set_timestep(int hz)
+	{
+		if(hz <= 0)
+			return;
+		pace_step_period = 1000000/hz;
+		pace_accum = 0;
+		pace_steps = 0;
+	}
+	/* Is another update due? */
+	int step()
+	{
+		long long now;
+		/* Bank the time that passed */
+		now = System::get_micro();
+		if(!pace_step_last)
+			pace_step_last = now;
+		pace_accum += now-pace_step_last;
+		pace_step_last = now;
+		/* Run an update */
+		if(pace_accum >= pace_step_period && pace_steps < PACE_MAX_STEPS)
+		{
+			pace_accum -= pace_step_period;
+			pace_steps++;
+			return 1;
+		}
+		/* Hit the limit, drop the whole updates we could not afford */
+		if(pace_steps >= PACE_MAX_STEPS)
+			pace_accum %= pace_step_period;
+		pace_steps = 0;
+		return 0;
+	}
+	/* Get update length */
+	float get_delta()
+	{
+		return ((float)pace_step_period)/1000000.0f;
+	}
+	/* Get interpolation factor */
+	float get_alpha()
+	{
+		return ((float)pace_accum)/((float)pace_step_period);
+	}
+}
\ No newline at end of file
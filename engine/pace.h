@@ -0,0 +1,74 @@
+#ifndef PACE_H
+#define PACE_H
+
+/* Defines */
+#define PACE_DEFAULT_FPS 60
+#define PACE_DEFAULT_SPIN 2000 /* Microseconds spun before a deadline instead of sleeping, to start with */
+#define PACE_MAX_SPIN 4000 /* Most the spin margin can grow to */
+#define PACE_MAX_STEPS 5 /* Most fixed updates run in one frame before time is dropped */
+
+/* REMARKS: */
+/*
+	Pace::wait is called once per frame after Video::end.
+	It sleeps while the next frame deadline is far away and spins for the last moment,
+	the spin margin adapts to how late the system actually wakes us up.
+	Deadlines advance by whole frame periods, a frame that runs long resynchronizes instead of
+	making the following ones rush to catch up.
+
+	For a fixed update rate independent of rendering:
+		while(Pace::step())
+			update(Pace::get_delta());
+		render(Pace::get_alpha());
+*/
+
+/* Frame timing statistics (in microseconds) */
+typedef struct
+{
+	int frames; /* Frames measured */
+	int average; /* Average frame time */
+	int minimum; /* Shortest frame */
+	int maximum; /* Longest frame */
+	int jitter; /* Average distance of frame time from the target */
+}PaceStats;
+
+/* Pace */
+namespace Pace
+{
+	/*
+		Sets the target frame rate
+		fps - frames per second (0 for unlimited)
+	*/
+	extern void set_target(int fps);
+	/*
+		Waits until it is time for the next frame, also measures the frame that just ended
+	*/
+	extern void wait();
+	/*
+		Gets the frame statistics since the last reset
+		s - output statistics
+	*/
+	extern void get_stats(PaceStats *s);
+	/*
+		Clears frame statistics
+	*/
+	extern void reset_stats();
+	/*
+		Sets the fixed update rate used by step
+		hz - updates per second
+	*/
+	extern void set_timestep(int hz);
+	/*
+		Returns 1 while another fixed update is due this frame, 0 once caught up
+	*/
+	extern int step();
+	/*
+		Gets the length of one fixed update (in seconds)
+	*/
+	extern float get_delta();
+	/*
+		Gets how far rendering is between the last two fixed updates (0 to 1)
+	*/
+	extern float get_alpha();
+}
+
+#endif
\ No newline at end of file
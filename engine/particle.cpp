@@ -0,0 +1,201 @@
+/*
+	Particle - Particle systems
+*/
+
+/* Includes */
+#include <math.h>
+#include <memory.h>
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#include "particle.h"
+#include "geo.h"
+#include "video.h"
+
+/* New particles */
+Particles :: Particles(int n)
+{
+	if(n < 0)
+		n = 0;
+	count = 0;
+	capacity = n;
+	/* Room for a whole group of four past the end */
+	n = (n+3)&~3;
+	xs = new float[n];
+	ys = new float[n];
+	zs = new float[n];
+	vxs = new float[n];
+	vys = new float[n];
+	vzs = new float[n];
+	lives = new float[n];
+	spans = new float[n];
+	sizes = new float[n];
+	colors = new int[n];
+	memset(xs,0,sizeof(float)*n);
+	memset(ys,0,sizeof(float)*n);
+	memset(zs,0,sizeof(float)*n);
+	memset(vxs,0,sizeof(float)*n);
+	memset(vys,0,sizeof(float)*n);
+	memset(vzs,0,sizeof(float)*n);
+	memset(lives,0,sizeof(float)*n);
+	memset(spans,0,sizeof(float)*n);
+	memset(sizes,0,sizeof(float)*n);
+	memset(colors,0,sizeof(int)*n);
+	gravity[0] = 0.0f;
+	gravity[1] = 0.0f;
+	gravity[2] = 0.0f;
+}
+
+/* Delete particles */
+Particles :: ~Particles()
+{
+	delete[] xs;
+	delete[] ys;
+	delete[] zs;
+	delete[] vxs;
+	delete[] vys;
+	delete[] vzs;
+	delete[] lives;
+	delete[] spans;
+	delete[] sizes;
+	delete[] colors;
+}
+
+/* Emit particle */
+int Particles :: emit(float x,float y,float z,float vx,float vy,float vz,float life,float size,int c)
+{
+	if(count >= capacity)
+		return PARTICLE_ERROR_FULL;
+	xs[count] = x;
+	ys[count] = y;
+	zs[count] = z;
+	vxs[count] = vx;
+	vys[count] = vy;
+	vzs[count] = vz;
+	lives[count] = life;
+	spans[count] = (life > 0.0f) ? life : 1.0f;
+	sizes[count] = size;
+	colors[count] = c;
+	return count++;
+}
+
+/* Set gravity */
+void Particles :: set_gravity(float x,float y,float z)
+{
+	gravity[0] = x;
+	gravity[1] = y;
+	gravity[2] = z;
+}
+
+/* Update particles */
+void Particles :: update(float dt)
+{
+	__m128 t,gx,gy,gz,vx,vy,vz;
+	int i,last;
+	/* Move four at a time (spare lanes past the end move too, nobody looks at them) */
+	t = _mm_set1_ps(dt);
+	gx = _mm_set1_ps(gravity[0]*dt);
+	gy = _mm_set1_ps(gravity[1]*dt);
+	gz = _mm_set1_ps(gravity[2]*dt);
+	for(i = 0;i < count;i += 4)
+	{
+		vx = _mm_add_ps(_mm_loadu_ps(&vxs[i]),gx);
+		vy = _mm_add_ps(_mm_loadu_ps(&vys[i]),gy);
+		vz = _mm_add_ps(_mm_loadu_ps(&vzs[i]),gz);
+		_mm_storeu_ps(&vxs[i],vx);
+		_mm_storeu_ps(&vys[i],vy);
+		_mm_storeu_ps(&vzs[i],vz);
+		_mm_storeu_ps(&xs[i],_mm_add_ps(_mm_loadu_ps(&xs[i]),_mm_mul_ps(vx,t)));
+		_mm_storeu_ps(&ys[i],_mm_add_ps(_mm_loadu_ps(&ys[i]),_mm_mul_ps(vy,t)));
+		_mm_storeu_ps(&zs[i],_mm_add_ps(_mm_loadu_ps(&zs[i]),_mm_mul_ps(vz,t)));
+		_mm_storeu_ps(&lives[i],_mm_sub_ps(_mm_loadu_ps(&lives[i]),t));
+	}
+	/* Replace the dead with the last particle */
+	for(i = 0;i < count;)
+	{
+		if(lives[i] > 0.0f)
+		{
+			i++;
+			continue;
+		}
+		last = --count;
+		xs[i] = xs[last];
+		ys[i] = ys[last];
+		zs[i] = zs[last];
+		vxs[i] = vxs[last];
+		vys[i] = vys[last];
+		vzs[i] = vzs[last];
+		lives[i] = lives[last];
+		spans[i] = spans[last];
+		sizes[i] = sizes[last];
+		colors[i] = colors[last];
+	}
+}
+
+/* Draw particles */
+void Particles :: draw(int mode)
+{
+	__m128 x,y,z,w,px,py,r,near;
+	float m[16],fx[4],fy[4],fr[4],fw[4],l,half,f;
+	int i,j,c,fade;
+	Matrix *combined;
+	combined = Geo::get_combined();
+	for(i = 0;i < 16;i++)
+		m[i] = combined->get(i>>2,i&3);
+	/* Size on screen scales like screen_size does, x like Geo places points */
+	l = sqrtf(m[4]*m[4]+m[5]*m[5]+m[6]*m[6]);
+	half = 0.5f*(float)Video::get_height();
+	near = _mm_set1_ps(GEO_NEAR_W);
+	for(i = 0;i < count;i += 4)
+	{
+		/* Project four centers */
+		x = _mm_loadu_ps(&xs[i]);
+		y = _mm_loadu_ps(&ys[i]);
+		z = _mm_loadu_ps(&zs[i]);
+		px = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x,_mm_set1_ps(m[0])),_mm_mul_ps(y,_mm_set1_ps(m[1]))),_mm_add_ps(_mm_mul_ps(z,_mm_set1_ps(m[2])),_mm_set1_ps(m[3])));
+		py = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x,_mm_set1_ps(m[4])),_mm_mul_ps(y,_mm_set1_ps(m[5]))),_mm_add_ps(_mm_mul_ps(z,_mm_set1_ps(m[6])),_mm_set1_ps(m[7])));
+		w = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x,_mm_set1_ps(m[12])),_mm_mul_ps(y,_mm_set1_ps(m[13]))),_mm_add_ps(_mm_mul_ps(z,_mm_set1_ps(m[14])),_mm_set1_ps(m[15])));
+		_mm_storeu_ps(fw,w);
+		/* Divide (points behind the camera are dropped below) */
+		w = _mm_div_ps(_mm_set1_ps(1.0f),_mm_max_ps(w,near));
+		px = _mm_mul_ps(px,w);
+		py = _mm_mul_ps(py,w);
+		r = _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(&sizes[i]),_mm_set1_ps(0.5f*l*half)),w);
+		/* To pixels */
+		px = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(px,_mm_set1_ps(0.5f*(float)Video::get_height()/(float)Video::get_width())),_mm_set1_ps(0.5f)),_mm_set1_ps((float)Video::get_width()));
+		py = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(py,_mm_set1_ps(0.5f)),_mm_set1_ps(0.5f)),_mm_set1_ps((float)Video::get_height()));
+		_mm_storeu_ps(fx,px);
+		_mm_storeu_ps(fy,py);
+		_mm_storeu_ps(fr,r);
+		for(j = 0;j < 4 && i+j < count;j++)
+		{
+			if(fw[j] <= GEO_NEAR_W)
+				continue;
+			c = colors[i+j];
+			/* Fade out over its life */
+			if(mode&DRAW_BLEND)
+			{
+				f = lives[i+j]/spans[i+j];
+				if(f > 1.0f)
+					f = 1.0f;
+				fade = (int)(f*255.0f);
+				if(mode&DRAW_BLEND_OPS)
+					c = Draw::multiply_color(c,0xFF000000|(fade*0x010101));
+				else
+					c = (int)(((unsigned int)c&0x00FFFFFF)|((((unsigned int)c>>24)*fade/255)<<24));
+			}
+			Draw::point((int)fx[j],(int)fy[j],(int)fr[j],c,mode);
+		}
+	}
+}
+
+/* Remove particles */
+void Particles :: clear()
+{
+	count = 0;
+}
+
+/* Get particle count */
+int Particles :: get_count()
+{
+	return count;
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+#ifndef PARTICLE_H
+#define PARTICLE_H
+
+/* Error codes */
+#define PARTICLE_ERROR_FULL -1
+
+/* REMARKS: */
+/*
+	Particles are kept as separate arrays of each component, so update moves four at a time with SSE
+	and dead particles are removed by moving the last one into their place (order is not kept).
+	Drawing projects the centers four at a time through the current Geo transform and camera,
+	then draws each one as a square Draw::point sized by its distance, skipping the triangle path.
+	Particles fade out over their life, blended ones by alpha (or by color with a blend operation),
+	and are drawn in the order they are stored, which suits additive effects best.
+*/
+
+/* Particles */
+class Particles
+{
+private:
+	int count; /* Count of live particles */
+	int capacity; /* Most particles (rounded up to 4) */
+	float *xs; /* Positions */
+	float *ys;
+	float *zs;
+	float *vxs; /* Velocities */
+	float *vys;
+	float *vzs;
+	float *lives; /* Time left to live */
+	float *spans; /* Time each one started with */
+	float *sizes; /* Sizes (world units across) */
+	int *colors; /* Colors */
+	float gravity[3]; /* Acceleration of every particle */
+public:
+	/*
+		Creates an empty particle system
+		n - most particles
+	*/
+	Particles(int n);
+	~Particles();
+	/*
+		Adds a particle
+		Returns particle index or error code
+		x,y,z - position
+		vx,vy,vz - velocity
+		life - time it lives (in seconds)
+		size - size (world units across)
+		c - color
+	*/
+	int emit(float x,float y,float z,float vx,float vy,float vz,float life,float size,int c);
+	/*
+		Sets acceleration of every particle
+	*/
+	void set_gravity(float x,float y,float z);
+	/*
+		Moves every particle and removes the dead ones
+		dt - time passed (in seconds)
+	*/
+	void update(float dt);
+	/*
+		Draws every particle
+		mode - DRAW_BLEND (and a blend operation) to blend, otherwise they are filled
+	*/
+	void draw(int mode);
+	/*
+		Removes every particle
+	*/
+	void clear();
+	/*
+		Gets particle count
+	*/
+	int get_count();
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,195 @@
+/*
+	Portals - Rooms seen through doors
+*/
+
+/* Includes */
+#include <memory.h>
+#include "portal.h"
+#include "geo.h"
+#include "video.h"
+
+/* New interior */
+Portals :: Portals(int r,int d)
+{
+	if(r < 0)
+		r = 0;
+	if(d < 0)
+		d = 0;
+	rooms = new PortalRoom[r];
+	room_count = 0;
+	room_capacity = r;
+	sides = new PortalSide[d*2];
+	corners = new float[d*12];
+	open = new int[d];
+	door_count = 0;
+	door_capacity = d;
+	rooms_drawn = 0;
+}
+
+/* Delete interior */
+Portals :: ~Portals()
+{
+	delete[] rooms;
+	delete[] sides;
+	delete[] corners;
+	delete[] open;
+}
+
+/* Add room */
+int Portals :: add_room(Mesh *m,Texture *t,int mode)
+{
+	PortalRoom *r;
+	if(room_count >= room_capacity)
+		return PORTAL_ERROR_FULL;
+	r = &rooms[room_count];
+	r->mesh = m;
+	r->texture = t;
+	r->mode = mode;
+	r->door = -1;
+	r->drawn = 0;
+	r->looking = 0;
+	return room_count++;
+}
+
+/* Add door */
+int Portals :: add_door(int a,int b,float *c)
+{
+	int d;
+	if(door_count >= door_capacity)
+		return PORTAL_ERROR_FULL;
+	if(a < 0 || a >= room_count || b < 0 || b >= room_count)
+		return PORTAL_ERROR_ROOM;
+	d = door_count++;
+	memcpy(&corners[d*12],c,sizeof(float)*12);
+	open[d] = 1;
+	/* One side leads out of each room */
+	sides[d*2].to = b;
+	sides[d*2].next = rooms[a].door;
+	rooms[a].door = d*2;
+	sides[d*2+1].to = a;
+	sides[d*2+1].next = rooms[b].door;
+	rooms[b].door = d*2+1;
+	return d;
+}
+
+/* Open or close door */
+void Portals :: set_open(int d,int o)
+{
+	if(d < 0 || d >= door_count)
+		return;
+	open[d] = o;
+}
+
+/* Find room */
+int Portals :: locate(float *p)
+{
+	float lo[3],hi[3];
+	int i;
+	for(i = 0;i < room_count;i++)
+	{
+		if(!rooms[i].mesh)
+			continue;
+		rooms[i].mesh->get_box(lo,hi);
+		if(p[0] >= lo[0] && p[0] <= hi[0] && p[1] >= lo[1] && p[1] <= hi[1] && p[2] >= lo[2] && p[2] <= hi[2])
+			return i;
+	}
+	return PORTAL_NONE;
+}
+
+/* Draw room and look through doors */
+void Portals :: visit(int r,int x0,int y0,int x1,int y1,int depth)
+{
+	PortalRoom *room;
+	float *c,lo[3],hi[3];
+	int s,d,i,x,y,dx0,dy0,dx1,dy1,behind;
+	room = &rooms[r];
+	/* Draw */
+	if(!room->drawn)
+	{
+		room->drawn = 1;
+		rooms_drawn++;
+		if(room->mesh)
+		{
+			Geo::texture(room->texture);
+			Geo::mode(room->mode);
+			room->mesh->draw();
+		}
+	}
+	if(depth >= PORTAL_MAX_DEPTH)
+		return;
+	/* Look through open doors, but never back into a room we are looking from */
+	room->looking = 1;
+	for(s = room->door;s >= 0;s = sides[s].next)
+	{
+		d = s>>1;
+		if(!open[d] || rooms[sides[s].to].looking)
+			continue;
+		/* Skip doorways out of view */
+		c = &corners[d*12];
+		for(i = 0;i < 3;i++)
+		{
+			lo[i] = c[i];
+			hi[i] = c[i];
+		}
+		for(i = 3;i < 12;i++)
+		{
+			if(c[i] < lo[i%3]) lo[i%3] = c[i];
+			if(c[i] > hi[i%3]) hi[i%3] = c[i];
+		}
+		if(Geo::cull_box(lo,hi))
+			continue;
+		/* Rectangle around the doorway on screen */
+		behind = 0;
+		dx0 = dy0 = 0x7FFFFFFF;
+		dx1 = dy1 = -0x7FFFFFFF;
+		for(i = 0;i < 4;i++)
+		{
+			Vector v(c[i*3],c[i*3+1],c[i*3+2],1.0f);
+			v.multiply(Geo::get_combined());
+			if(v.get_w() <= GEO_NEAR_W)
+			{
+				behind = 1;
+				break;
+			}
+			Geo::screen(&v,&x,&y);
+			if(x < dx0) dx0 = x;
+			if(y < dy0) dy0 = y;
+			if(x > dx1) dx1 = x;
+			if(y > dy1) dy1 = y;
+		}
+		/* Cut down to what we see it through */
+		if(behind)
+		{
+			dx0 = x0;
+			dy0 = y0;
+			dx1 = x1;
+			dy1 = y1;
+		}
+		if(dx0 < x0) dx0 = x0;
+		if(dy0 < y0) dy0 = y0;
+		if(dx1 > x1) dx1 = x1;
+		if(dy1 > y1) dy1 = y1;
+		if(dx0 > dx1 || dy0 > dy1)
+			continue;
+		visit(sides[s].to,dx0,dy0,dx1,dy1,depth+1);
+	}
+	room->looking = 0;
+}
+
+/* Draw visible rooms */
+void Portals :: draw(int r)
+{
+	int i;
+	rooms_drawn = 0;
+	if(r < 0 || r >= room_count)
+		return;
+	for(i = 0;i < room_count;i++)
+		rooms[i].drawn = 0;
+	visit(r,0,0,Video::get_width()-1,Video::get_height()-1,0);
+}
+
+/* Get count of rooms drawn */
+int Portals :: get_rooms_drawn()
+{
+	return rooms_drawn;
+}
\ No newline at end of file
@@ -0,0 +1,109 @@
+#ifndef PORTAL_H
+#define PORTAL_H
+
+/* Defines */
+#define PORTAL_MAX_DEPTH 16 /* Most doorways looked through in a row */
+#define PORTAL_NONE -1 /* No room */
+#define PORTAL_ERROR_FULL -1
+#define PORTAL_ERROR_ROOM -2
+
+/* Includes */
+#include "draw.h"
+#include "mesh.h"
+
+/* REMARKS: */
+/*
+	Interiors are split into rooms joined by doors, each door is a quad in the wall between two rooms.
+	Drawing starts in the room holding the camera with the whole screen as the visible rectangle.
+	Every open door of a drawn room is projected with the current Geo transform and camera,
+	the rectangle around it is cut down to the rectangle it was seen through,
+	and the room behind it is only drawn if anything is left. Closed doors block the view entirely.
+	A room is drawn at most once per draw, no matter how many doors it is seen through.
+	Doors that cross the near plane cannot be projected and keep the rectangle they were seen through.
+*/
+
+/* Room */
+typedef struct
+{
+	Mesh *mesh; /* What is drawn */
+	Texture *texture;
+	int mode;
+	int door; /* First door side leading out of the room (-1 for none) */
+	int drawn; /* Drawn in the current draw? */
+	int looking; /* Currently being looked through? */
+}PortalRoom;
+
+/* One side of a door */
+typedef struct
+{
+	int to; /* Room on the other side */
+	int next; /* Next door side leading out of the same room (-1 for none) */
+}PortalSide;
+
+/* Portals */
+class Portals
+{
+private:
+	PortalRoom *rooms; /* Rooms */
+	int room_count;
+	int room_capacity;
+	PortalSide *sides; /* Door sides (door d is sides 2d and 2d+1) */
+	float *corners; /* Door corners (12 floats per door) */
+	int *open; /* Is door open? */
+	int door_count;
+	int door_capacity;
+	int rooms_drawn; /* Rooms drawn in the last draw */
+	/*
+		Draws a room and looks through its doors
+		r - the room
+		x0,y0,x1,y1 - screen rectangle it is seen through
+		depth - doorways looked through so far
+	*/
+	void visit(int r,int x0,int y0,int x1,int y1,int depth);
+public:
+	/*
+		Creates a new empty interior
+		r - most rooms
+		d - most doors
+	*/
+	Portals(int r,int d);
+	~Portals();
+	/*
+		Adds a room
+		Returns the new room or error code
+		m - the mesh
+		t - the texture
+		mode - render mode
+	*/
+	int add_room(Mesh *m,Texture *t,int mode);
+	/*
+		Adds an open door between two rooms
+		Returns the new door or error code
+		a,b - the rooms
+		c - the four corners of the doorway, in order around it (12 floats)
+	*/
+	int add_door(int a,int b,float *c);
+	/*
+		Opens or closes a door
+		d - the door
+		o - 1 to open, 0 to close
+	*/
+	void set_open(int d,int o);
+	/*
+		Finds the room whose mesh bounding box holds a point
+		Returns the room or PORTAL_NONE
+		p - the point (3 floats)
+	*/
+	int locate(float *p);
+	/*
+		Draws the rooms that can be seen from a room
+		r - room holding the camera
+	*/
+	void draw(int r);
+	/*
+		Gets count of rooms drawn in the last draw
+	*/
+	int get_rooms_drawn();
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,258 @@
+/*
+	Post - Full screen post-processing of the finished frame
+*/
+
+/* Includes */
+#include <math.h>
+#include <memory.h>
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#include "post.h"
+#include "video.h"
+#include "job.h"
+
+/* Post */
+namespace Post
+{
+	/* Globals */
+	int post_fade_color = 0; /* Color to fade toward */
+	int post_fade_amount = 0; /* .. and how far (0 to 255) */
+	int post_brightness = 0; /* Levels */
+	float post_contrast = 1.0f;
+	float post_user[12]; /* Color matrix */
+	int post_user_on = 0; /* .. and if it is set */
+	int *post_clut = 0; /* Color lookup table */
+	float post_matrix[12] = {1,0,0,0,0,1,0,0,0,0,1,0}; /* Every affine effect combined */
+	int post_affine = 0; /* If the combined matrix does anything */
+	int post_diagonal = 0; /* If it only scales and offsets each channel on its own (integer fast path) */
+	short post_scales[8]; /* .. as scale (8.8 fixed point) and offset (1/16 steps) pairs for each channel */
+	/* Combines the affine effects */
+	void combine()
+	{
+		float k,o,a;
+		int i,j;
+		static const float identity[12] = {1,0,0,0,0,1,0,0,0,0,1,0};
+		memcpy(post_matrix,post_user_on ? post_user : identity,sizeof(post_matrix));
+		k = post_contrast;
+		o = 128.0f-128.0f*k+(float)post_brightness;
+		a = (float)post_fade_amount/255.0f;
+		for(i = 0;i < 3;i++)
+		{
+			/* Levels */
+			for(j = 0;j < 4;j++)
+				post_matrix[i*4+j] *= k;
+			post_matrix[i*4+3] += o;
+			/* Fade */
+			for(j = 0;j < 4;j++)
+				post_matrix[i*4+j] *= 1.0f-a;
+			post_matrix[i*4+3] += a*(float)((post_fade_color>>(i*8))&0xFF);
+		}
+		post_affine = memcmp(post_matrix,identity,sizeof(post_matrix)) != 0;
+		/* Without cross terms each channel is scaled in 16 bits, scales must stay small enough not to overflow */
+		post_diagonal = 1;
+		for(i = 0;i < 3;i++)
+		{
+			for(j = 0;j < 3;j++)
+			{
+				if(i != j && post_matrix[i*4+j] != 0.0f)
+					post_diagonal = 0;
+			}
+			k = post_matrix[i*4+i];
+			o = post_matrix[i*4+3];
+			if(k <= -127.0f || k >= 127.0f || o <= -2000.0f || o >= 2000.0f)
+				post_diagonal = 0;
+		}
+		if(!post_diagonal)
+			return;
+		/* Offsets carry the half for rounding, alpha is kept */
+		for(i = 0;i < 4;i++)
+		{
+			post_scales[i*2] = (i < 3) ? (short)floorf(post_matrix[i*5]*256.0f+0.5f) : 256;
+			post_scales[i*2+1] = (short)((i < 3) ? floorf(post_matrix[i*4+3]*16.0f+0.5f)+8 : 8);
+		}
+	}
+	/* Set fade */
+	void fade(int c,int a)
+	{
+		if(a < 0) a = 0;
+		if(a > 255) a = 255;
+		post_fade_color = c;
+		post_fade_amount = a;
+		combine();
+	}
+	/* Set levels */
+	void levels(int brightness,float contrast)
+	{
+		post_brightness = brightness;
+		post_contrast = contrast;
+		combine();
+	}
+	/* Set color matrix */
+	void color_matrix(float *m)
+	{
+		post_user_on = m != 0;
+		if(m)
+			memcpy(post_user,m,sizeof(post_user));
+		combine();
+	}
+	/* Set color lookup table */
+	void clut(int *t)
+	{
+		post_clut = t;
+	}
+	/* Build color lookup table */
+	void build_clut(int *t,int *p,int n)
+	{
+		int i,j,r,g,b,dr,dg,db,d,best,least;
+		for(i = 0;i < POST_CLUT_SIZE;i++)
+		{
+			/* Middle of the 5-bit step */
+			r = ((i&0x1F)<<3)|4;
+			g = (((i>>5)&0x1F)<<3)|4;
+			b = (((i>>10)&0x1F)<<3)|4;
+			best = 0;
+			least = 0x7FFFFFFF;
+			for(j = 0;j < n;j++)
+			{
+				dr = (p[j]&0xFF)-r;
+				dg = ((p[j]>>8)&0xFF)-g;
+				db = ((p[j]>>16)&0xFF)-b;
+				d = dr*dr+dg*dg+db*db;
+				if(d < least)
+				{
+					least = d;
+					best = j;
+				}
+			}
+			t[i] = n ? p[best] : 0;
+		}
+	}
+	/* Turn everything off */
+	void reset()
+	{
+		post_fade_amount = 0;
+		post_brightness = 0;
+		post_contrast = 1.0f;
+		post_user_on = 0;
+		post_clut = 0;
+		combine();
+	}
+	/* Get if anything is on */
+	int is_active()
+	{
+		return post_affine || post_clut;
+	}
+	/* Apply the combined matrix to four pixels */
+	inline __m128i transform4(__m128i v,__m128 *m)
+	{
+		__m128 r,g,b,zero,full;
+		__m128i low;
+		zero = _mm_setzero_ps();
+		full = _mm_set1_ps(255.0f);
+		low = _mm_set1_epi32(0xFF);
+		r = _mm_cvtepi32_ps(_mm_and_si128(v,low));
+		g = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v,8),low));
+		b = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v,16),low));
+		v = _mm_and_si128(v,_mm_set1_epi32(0xFF000000));
+		/* Each channel from all three, clamped and rounded */
+#define POST_CHANNEL(i) _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(r,m[i*4]),_mm_mul_ps(g,m[i*4+1])), \
+                        _mm_add_ps(_mm_mul_ps(b,m[i*4+2]),m[i*4+3])),zero),full))
+		v = _mm_or_si128(v,POST_CHANNEL(0));
+		v = _mm_or_si128(v,_mm_slli_epi32(POST_CHANNEL(1),8));
+		v = _mm_or_si128(v,_mm_slli_epi32(POST_CHANNEL(2),16));
+#undef POST_CHANNEL
+		return v;
+	}
+	/* Scale and offset four pixels channel by channel, each channel is paired with 16 to pick up the offset */
+	inline __m128i scale4(__m128i v,__m128i k)
+	{
+		__m128i lo,hi,zero,sixteen;
+		zero = _mm_setzero_si128();
+		sixteen = _mm_set1_epi16(16);
+		lo = _mm_unpacklo_epi8(v,zero);
+		hi = _mm_unpackhi_epi8(v,zero);
+		lo = _mm_packs_epi32(_mm_srai_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(lo,sixteen),k),8),
+		                     _mm_srai_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(lo,sixteen),k),8));
+		hi = _mm_packs_epi32(_mm_srai_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(hi,sixteen),k),8),
+		                     _mm_srai_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(hi,sixteen),k),8));
+		return _mm_packus_epi16(lo,hi);
+	}
+	/* Apply to a run */
+	void apply_span(int *p,int n)
+	{
+		__m128 m[12];
+		__m128i k;
+		int i,c,tail[4];
+		if(post_affine && post_diagonal)
+		{
+			k = _mm_loadu_si128((__m128i*)post_scales);
+			for(i = 0;i+4 <= n;i += 4)
+				_mm_storeu_si128((__m128i*)&p[i],scale4(_mm_loadu_si128((__m128i*)&p[i]),k));
+			if(i < n)
+			{
+				memcpy(tail,&p[i],sizeof(int)*(n-i));
+				_mm_storeu_si128((__m128i*)tail,scale4(_mm_loadu_si128((__m128i*)tail),k));
+				memcpy(&p[i],tail,sizeof(int)*(n-i));
+			}
+		}
+		else if(post_affine)
+		{
+			for(i = 0;i < 12;i++)
+				m[i] = _mm_set1_ps(post_matrix[i]);
+			for(i = 0;i+4 <= n;i += 4)
+				_mm_storeu_si128((__m128i*)&p[i],transform4(_mm_loadu_si128((__m128i*)&p[i]),m));
+			/* Last few through a padded copy */
+			if(i < n)
+			{
+				memcpy(tail,&p[i],sizeof(int)*(n-i));
+				_mm_storeu_si128((__m128i*)tail,transform4(_mm_loadu_si128((__m128i*)tail),m));
+				memcpy(&p[i],tail,sizeof(int)*(n-i));
+			}
+		}
+		/* Table lookups do not vectorize without a gather */
+		if(post_clut)
+		{
+			for(i = 0;i < n;i++)
+			{
+				c = p[i];
+				p[i] = (post_clut[((c>>3)&0x001F)|((c>>6)&0x03E0)|((c>>9)&0x7C00)]&0x00FFFFFF)|(c&0xFF000000);
+			}
+		}
+	}
+	/* Apply to a band of rows */
+	void apply_band(void *data,int item)
+	{
+		int buf[POST_CHUNK];
+		int x,y,y2,n,w,direct;
+		w = Video::get_width();
+		y = item*POST_BAND;
+		y2 = y+POST_BAND;
+		if(y2 > Video::get_height())
+			y2 = Video::get_height();
+		direct = Video::get_format() == VIDEO_FORMAT_32;
+		for(;y < y2;y++)
+		{
+			/* 32-bit rows are worked on in place */
+			if(direct)
+			{
+				apply_span(Video::get_data(0,y),w);
+				continue;
+			}
+			for(x = 0;x < w;x += n)
+			{
+				n = (w-x < POST_CHUNK) ? w-x : POST_CHUNK;
+				Video::read_span(x,y,n,buf);
+				apply_span(buf,n);
+				Video::write_span(x,y,n,buf);
+			}
+		}
+	}
+	/* Apply to the frame */
+	void apply()
+	{
+		if(!is_active())
+			return;
+		Job::run((Video::get_height()+POST_BAND-1)/POST_BAND,apply_band,0);
+		Video::mark_all_dirty();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,79 @@
+#ifndef POST_H
+#define POST_H
+
+/* Defines */
+#define POST_BAND 8 /* Rows in each job item */
+#define POST_CHUNK 256 /* Pixels processed at a time */
+#define POST_CLUT_SIZE 32768 /* Entries in a color lookup table (one per RGB555 color) */
+
+/* REMARKS: */
+/*
+	Post-processing runs over the finished frame in Video::end, just before it is shown,
+	so whole screen fades, flashes and tints cost one pass instead of a full screen triangle.
+	Effects stay on until changed. The color matrix, levels and fade are all affine, so they are
+	folded into one 3x4 matrix applied four pixels at a time with SSE, in that order.
+	Without a color matrix (or one with no cross terms) the channels are simply scaled and offset
+	in 16-bit integers instead, which is faster but may be a step off.
+	The color lookup table (CLUT) is applied last, indexed by the top 5 bits of each channel,
+	for palette effects like sepia, night vision or locking the frame to a palette.
+	Rows are split into bands that run across the job workers.
+	Alpha (the extra channel) is kept as it is.
+	While any effect is on the whole frame is marked dirty, so dirty mode saves nothing.
+*/
+
+/* Post */
+namespace Post
+{
+	/*
+		Sets a fade toward a color, for fades and flashes
+		c - the color
+		a - amount (0 for none, 255 for only the color)
+	*/
+	extern void fade(int c,int a);
+	/*
+		Sets brightness and contrast
+		Channels become (x-128)*contrast+128+brightness
+		brightness - added to every channel (0 for none)
+		contrast - scale around the middle gray (1 for none)
+	*/
+	extern void levels(int brightness,float contrast);
+	/*
+		Sets the color matrix, used for tints, grayscale and channel swaps
+		Each channel becomes a weighted sum of the red, green and blue channels plus an offset
+		m - 3 rows (red, green, blue) of 4 floats (red, green and blue weights, then offset), 0 to remove
+	*/
+	extern void color_matrix(float *m);
+	/*
+		Sets the color lookup table
+		t - POST_CLUT_SIZE colors indexed by r|g<<5|b<<10 (channels cut to 5 bits), 0 to remove
+		Kept by pointer, the owner keeps it alive
+	*/
+	extern void clut(int *t);
+	/*
+		Fills a color lookup table that maps every color to the nearest color of a palette
+		t - the table (POST_CLUT_SIZE colors)
+		p - the palette
+		n - count of palette colors
+	*/
+	extern void build_clut(int *t,int *p,int n);
+	/*
+		Turns every effect off
+	*/
+	extern void reset();
+	/*
+		Gets if any effect is on
+	*/
+	extern int is_active();
+	/*
+		Applies the effects to a run of pixels
+		p - the pixels
+		n - count of pixels
+	*/
+	extern void apply_span(int *p,int n);
+	/*
+		Applies the effects to the whole frame (called by Video::end)
+	*/
+	extern void apply();
+}
+
+#endif
\ No newline at end of file
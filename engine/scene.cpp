@@ -0,0 +1,324 @@
+/*
+	Scene - Hierarchy of transformed nodes
+*/
+
+/* Includes */
+#include "scene.h"
+#include <math.h>
+#include "geo.h"
+#include "video.h"
+
+/* New scene */
+Scene :: Scene(int n)
+{
+	if(n < 0)
+		n = 0;
+	capacity = n;
+	count = 0;
+	updated = 0;
+	parents = new int[n];
+	flags = new int[n];
+	positions = new float[n*3];
+	rotations = new float[n*4];
+	scales = new float[n*3];
+	locals = new Matrix[n];
+	worlds = new Matrix[n];
+	meshes = new Mesh*[n];
+	textures = new Texture*[n];
+	modes = new int[n];
+	occluders = new Mesh*[n];
+	lods = new int[n];
+	bound_x = new float[n];
+	bound_y = new float[n];
+	bound_z = new float[n];
+	bound_r = new float[n];
+}
+
+/* Delete scene */
+Scene :: ~Scene()
+{
+	delete[] parents;
+	delete[] flags;
+	delete[] positions;
+	delete[] rotations;
+	delete[] scales;
+	delete[] locals;
+	delete[] worlds;
+	delete[] meshes;
+	delete[] textures;
+	delete[] modes;
+	delete[] occluders;
+	delete[] lods;
+	delete[] bound_x;
+	delete[] bound_y;
+	delete[] bound_z;
+	delete[] bound_r;
+}
+
+/* Add node */
+int Scene :: add(int p)
+{
+	int n;
+	if(count >= capacity)
+		return SCENE_ERROR_FULL;
+	/* Parents must come first, so update can run front to back */
+	if(p != SCENE_ROOT && (p < 0 || p >= count))
+		return SCENE_ERROR_PARENT;
+	n = count++;
+	parents[n] = p;
+	flags[n] = SCENE_WORLD_DIRTY;
+	positions[n*3] = 0.0f;
+	positions[n*3+1] = 0.0f;
+	positions[n*3+2] = 0.0f;
+	rotations[n*4] = 0.0f;
+	rotations[n*4+1] = 0.0f;
+	rotations[n*4+2] = 0.0f;
+	rotations[n*4+3] = 1.0f;
+	scales[n*3] = 1.0f;
+	scales[n*3+1] = 1.0f;
+	scales[n*3+2] = 1.0f;
+	locals[n].identity();
+	worlds[n].identity();
+	meshes[n] = 0;
+	textures[n] = 0;
+	modes[n] = DRAW_GOURAD|DRAW_TEXTURE|DRAW_BLEND;
+	occluders[n] = 0;
+	lods[n] = -1;
+	bound_x[n] = 0.0f;
+	bound_y[n] = 0.0f;
+	bound_z[n] = 0.0f;
+	bound_r[n] = 0.0f;
+	return n;
+}
+
+/* Remove all nodes */
+void Scene :: clear()
+{
+	count = 0;
+	updated = 0;
+}
+
+/* Set position */
+void Scene :: set_position(int n,float x,float y,float z)
+{
+	if(n < 0 || n >= count)
+		return;
+	positions[n*3] = x;
+	positions[n*3+1] = y;
+	positions[n*3+2] = z;
+	flags[n] = (flags[n]&~SCENE_RAW)|SCENE_LOCAL_DIRTY|SCENE_WORLD_DIRTY;
+}
+
+/* Set rotation */
+void Scene :: set_rotation(int n,float angle,float x,float y,float z)
+{
+	if(n < 0 || n >= count)
+		return;
+	rotations[n*4] = angle;
+	rotations[n*4+1] = x;
+	rotations[n*4+2] = y;
+	rotations[n*4+3] = z;
+	flags[n] = (flags[n]&~SCENE_RAW)|SCENE_LOCAL_DIRTY|SCENE_WORLD_DIRTY;
+}
+
+/* Set scale */
+void Scene :: set_scale(int n,float sx,float sy,float sz)
+{
+	if(n < 0 || n >= count)
+		return;
+	scales[n*3] = sx;
+	scales[n*3+1] = sy;
+	scales[n*3+2] = sz;
+	flags[n] = (flags[n]&~SCENE_RAW)|SCENE_LOCAL_DIRTY|SCENE_WORLD_DIRTY;
+}
+
+/* Set local matrix */
+void Scene :: set_local(int n,Matrix *m)
+{
+	if(n < 0 || n >= count)
+		return;
+	locals[n].set(m);
+	flags[n] = (flags[n]&~SCENE_LOCAL_DIRTY)|SCENE_RAW|SCENE_WORLD_DIRTY;
+}
+
+/* Set mesh */
+void Scene :: set_mesh(int n,Mesh *m,Texture *t,int mode)
+{
+	if(n < 0 || n >= count)
+		return;
+	meshes[n] = m;
+	lods[n] = -1;
+	textures[n] = t;
+	modes[n] = mode;
+	/* Bounds follow the world matrix */
+	flags[n] |= SCENE_WORLD_DIRTY;
+}
+
+/* Set occluder */
+void Scene :: set_occluder(int n,Mesh *m)
+{
+	if(n < 0 || n >= count)
+		return;
+	occluders[n] = m;
+}
+
+/* Show or hide */
+void Scene :: set_visible(int n,int v)
+{
+	if(n < 0 || n >= count)
+		return;
+	if(v)
+		flags[n] &= ~SCENE_HIDDEN;
+	else
+		flags[n] |= SCENE_HIDDEN;
+}
+
+/* Build local matrix */
+void Scene :: build_local(int n)
+{
+	float *r;
+	/* Scale, then rotate, then move */
+	r = &rotations[n*4];
+	locals[n].rotate(r[0],r[1],r[2],r[3]);
+	locals[n].multiply_scale(scales[n*3],scales[n*3+1],scales[n*3+2]);
+	locals[n].translate(positions[n*3],positions[n*3+1],positions[n*3+2]);
+}
+
+/* Find world bounds */
+void Scene :: bound(int n)
+{
+	float c[3],r,l,s;
+	Matrix *w;
+	int i;
+	if(!meshes[n])
+	{
+		bound_x[n] = bound_y[n] = bound_z[n] = bound_r[n] = 0.0f;
+		return;
+	}
+	meshes[n]->get_sphere(c,&r);
+	w = &worlds[n];
+	bound_x[n] = w->get(0,0)*c[0]+w->get(0,1)*c[1]+w->get(0,2)*c[2]+w->get(0,3);
+	bound_y[n] = w->get(1,0)*c[0]+w->get(1,1)*c[1]+w->get(1,2)*c[2]+w->get(1,3);
+	bound_z[n] = w->get(2,0)*c[0]+w->get(2,1)*c[1]+w->get(2,2)*c[2]+w->get(2,3);
+	/* Radius grows with the largest scale along any axis */
+	s = 0.0f;
+	for(i = 0;i < 3;i++)
+	{
+		l = w->get(0,i)*w->get(0,i)+w->get(1,i)*w->get(1,i)+w->get(2,i)*w->get(2,i);
+		if(l > s)
+			s = l;
+	}
+	bound_r[n] = r*(float)sqrt(s);
+}
+
+/* Update world matrices */
+void Scene :: update()
+{
+	int i,p,f;
+	updated = 0;
+	for(i = 0;i < count;i++)
+	{
+		/* Follow a parent that moved this update (parents are always earlier) */
+		p = parents[i];
+		f = flags[i]&~SCENE_MOVED;
+		if(p != SCENE_ROOT && (flags[p]&SCENE_MOVED))
+			f |= SCENE_WORLD_DIRTY;
+		if(!(f&SCENE_WORLD_DIRTY))
+		{
+			flags[i] = f;
+			continue;
+		}
+		/* Rebuild */
+		if(f&SCENE_LOCAL_DIRTY)
+			build_local(i);
+		if(p == SCENE_ROOT)
+			worlds[i].set(&locals[i]);
+		else
+		{
+			worlds[i].set(&worlds[p]);
+			if(locals[i].is_affine())
+				worlds[i].multiply_affine(&locals[i]);
+			else
+				worlds[i].multiply(&locals[i]);
+		}
+		bound(i);
+		flags[i] = (f&~(SCENE_LOCAL_DIRTY|SCENE_WORLD_DIRTY))|SCENE_MOVED;
+		updated++;
+	}
+}
+
+/* Draw scene */
+void Scene :: draw()
+{
+	int i,p,mark,*culled;
+	update();
+	Geo::push();
+	/* Cull every node at once in scene space */
+	Geo::identity();
+	mark = Video::get_arena()->get_mark();
+	culled = (int*)Video::frame_alloc(sizeof(int)*count);
+	if(culled)
+		Geo::cull_spheres(count,bound_x,bound_y,bound_z,bound_r,culled);
+	/* Work out which nodes are shown (hidden parents hide their children) */
+	for(i = 0;i < count;i++)
+	{
+		p = parents[i];
+		if(!(flags[i]&SCENE_HIDDEN) && (p == SCENE_ROOT || (flags[p]&SCENE_SHOWN)))
+			flags[i] |= SCENE_SHOWN;
+		else
+			flags[i] &= ~SCENE_SHOWN;
+	}
+	/* Occluders first */
+	for(i = 0;i < count;i++)
+	{
+		if(!occluders[i] || !(flags[i]&SCENE_SHOWN) || (culled && culled[i]))
+			continue;
+		Geo::load(&worlds[i]);
+		occluders[i]->occlude();
+	}
+	for(i = 0;i < count;i++)
+	{
+		if(!meshes[i] || !(flags[i]&SCENE_SHOWN))
+			continue;
+		if(culled && culled[i])
+		{
+			Geo::count_culled(1,meshes[i]->get_point_count());
+			continue;
+		}
+		/* Draw with the world matrix */
+		Geo::load(&worlds[i]);
+		Geo::texture(textures[i]);
+		Geo::mode(modes[i]);
+		meshes[i]->draw_lod(&lods[i]);
+	}
+	Video::get_arena()->rewind(mark);
+	Geo::pop();
+}
+
+/* Get world matrix */
+Matrix *Scene :: get_world(int n)
+{
+	if(n < 0 || n >= count)
+		return 0;
+	return &worlds[n];
+}
+
+/* Get parent */
+int Scene :: get_parent(int n)
+{
+	if(n < 0 || n >= count)
+		return SCENE_ROOT;
+	return parents[n];
+}
+
+/* Get count of nodes */
+int Scene :: get_count()
+{
+	return count;
+}
+
+/* Get count of rebuilt matrices */
+int Scene :: get_updated()
+{
+	return updated;
+}
\ No newline at end of file
@@ -0,0 +1,144 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+/* Defines */
+#define SCENE_ROOT -1 /* Parent of nodes at the top of the scene */
+#define SCENE_ERROR_FULL -1
+#define SCENE_ERROR_PARENT -2
+/* Node flags */
+#define SCENE_LOCAL_DIRTY 1 /* Local matrix needs rebuilding from position, rotation and scale */
+#define SCENE_WORLD_DIRTY 2 /* World matrix needs rebuilding */
+#define SCENE_MOVED 4 /* World matrix changed in the last update */
+#define SCENE_RAW 8 /* Local matrix was given directly */
+#define SCENE_HIDDEN 16 /* Node and its children are not drawn */
+#define SCENE_SHOWN 32 /* Node and all its parents are visible (set while drawing) */
+
+/* Includes */
+#include "vector.h"
+#include "draw.h"
+#include "mesh.h"
+
+/* REMARKS: */
+/*
+	Nodes live in flat arrays indexed by node number, and a parent is always added before its children.
+	That keeps the hierarchy in order so update is one pass from front to back,
+	a parent's world matrix is always ready by the time its children reach it.
+	Only nodes whose local transform changed, or whose parent moved, get their matrices rebuilt.
+	Nodes that never move (like level geometry) cost no matrix work at all after the first update.
+	World bounding spheres are kept alongside and only refreshed with the world matrix,
+	drawing culls them all in one batch before any mesh is touched.
+	Occluders of visible nodes are drawn first, so everything they hide is skipped.
+*/
+
+/* Scene */
+class Scene
+{
+private:
+	int capacity; /* Most nodes the scene can hold */
+	int count; /* Nodes in use */
+	int updated; /* World matrices rebuilt in the last update */
+	int *parents; /* Parent of each node (SCENE_ROOT for none) */
+	int *flags; /* Node flags */
+	float *positions; /* Local position (3 floats each) */
+	float *rotations; /* Local rotation as angle in degrees and axis (4 floats each) */
+	float *scales; /* Local scale (3 floats each) */
+	Matrix *locals; /* Local matrices */
+	Matrix *worlds; /* World matrices */
+	Mesh **meshes; /* Mesh of each node (0 for none) */
+	Texture **textures; /* Texture of each node */
+	int *modes; /* Render mode of each node */
+	Mesh **occluders; /* Occluder of each node (0 for none) */
+	int *lods; /* LOD each node was last drawn with */
+	float *bound_x; /* World bounding sphere of each node's mesh, split by component for batch culling */
+	float *bound_y;
+	float *bound_z;
+	float *bound_r;
+	/*
+		Moves a node's mesh bounding sphere into world space
+	*/
+	void bound(int n);
+	/*
+		Rebuilds a local matrix from position, rotation and scale
+	*/
+	void build_local(int n);
+public:
+	/*
+		Creates a new empty scene
+		n - most nodes the scene can hold
+	*/
+	Scene(int n);
+	~Scene();
+	/*
+		Adds a node with an identity transform
+		Returns the new node or error code
+		p - parent node (SCENE_ROOT for none)
+	*/
+	int add(int p);
+	/*
+		Removes all nodes
+	*/
+	void clear();
+	/*
+		Sets local transform parts of a node, applied as scale then rotation then position
+		n - the node
+	*/
+	void set_position(int n,float x,float y,float z);
+	void set_rotation(int n,float angle,float x,float y,float z);
+	void set_scale(int n,float sx,float sy,float sz);
+	/*
+		Sets the local matrix of a node directly, until a transform part is set again
+		n - the node
+		m - local matrix
+	*/
+	void set_local(int n,Matrix *m);
+	/*
+		Sets what is drawn at a node
+		n - the node
+		m - the mesh (0 for none)
+		t - the texture
+		mode - render mode
+	*/
+	void set_mesh(int n,Mesh *m,Texture *t,int mode);
+	/*
+		Sets the occluder of a node, drawn into the occlusion buffer before any node is drawn
+		n - the node
+		m - the occluder (0 for none), usually a simpler version of the node's mesh
+	*/
+	void set_occluder(int n,Mesh *m);
+	/*
+		Shows or hides a node and its children
+		n - the node
+		v - 1 to show, 0 to hide
+	*/
+	void set_visible(int n,int v);
+	/*
+		Rebuilds world matrices of nodes that moved
+	*/
+	void update();
+	/*
+		Updates, then draws every visible node that has a mesh and is not culled
+		World matrices replace the current Geo transform while drawing, it is restored afterwards
+		Geo texture and mode are left as those of the last node drawn
+	*/
+	void draw();
+	/*
+		Gets the world matrix of a node, as of the last update
+		n - the node
+	*/
+	Matrix *get_world(int n);
+	/*
+		Gets parent of a node
+		n - the node
+	*/
+	int get_parent(int n);
+	/*
+		Gets count of nodes
+	*/
+	int get_count();
+	/*
+		Gets count of world matrices rebuilt in the last update
+	*/
+	int get_updated();
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,110 @@
+/*
+	Sprite - Axis aligned sprite and tilemap drawing
+*/
+
+/* Includes */
+#include <memory.h>
+#include "sprite.h"
+#include "video.h"
+
+/* Sprite */
+namespace Sprite
+{
+	/* Copy a row */
+	void copy_row(int *d,int *s,int n,int flags)
+	{
+		if(flags == SPRITE_KEYED)
+			Draw::copy_keyed(d,s,n);
+		else
+			memcpy(d,s,sizeof(int)*n);
+	}
+	/* Draw sprite */
+	void blit(int x,int y,Texture *t,int sx,int sy,int w,int h,int flags)
+	{
+		int *data,row;
+		/* Clip to the texture */
+		if(sx < 0) { x -= sx; w += sx; sx = 0; }
+		if(sy < 0) { y -= sy; h += sy; sy = 0; }
+		if(sx+w > t->get_width())
+			w = t->get_width()-sx;
+		if(sy+h > t->get_height())
+			h = t->get_height()-sy;
+		/* Clip to the screen */
+		if(x < 0) { sx -= x; w += x; x = 0; }
+		if(y < 0) { sy -= y; h += y; y = 0; }
+		if(x+w > Video::get_width())
+			w = Video::get_width()-x;
+		if(y+h > Video::get_height())
+			h = Video::get_height()-y;
+		if(w <= 0 || h <= 0)
+			return;
+		Video::mark_dirty(x,y,w,h);
+		/* Copy row by row */
+		for(row = 0;row < h;row++)
+		{
+			if(flags == SPRITE_KEYED)
+			{
+				data = Video::get_span(x,y+row,w);
+				copy_row(data,&t->get_row(sy+row)[sx],w,flags);
+				Video::put_span();
+			}
+			else
+				Video::write_span(x,y+row,w,&t->get_row(sy+row)[sx]);
+		}
+	}
+	/* Draw batch */
+	void batch(Texture *t,int n,SpriteBlit *bs)
+	{
+		int i;
+		for(i = 0;i < n;i++)
+			blit(bs[i].x,bs[i].y,t,bs[i].sx,bs[i].sy,bs[i].w,bs[i].h,bs[i].flags);
+	}
+	/* Draw tilemap */
+	void tilemap(int x,int y,Texture *t,int size,int cols,int rows,int *map,int flags)
+	{
+		int *data,*line,*src,across,from,to,top,bottom,sy,my,ty,col,tx,n,tile,i;
+		if(size <= 0 || cols <= 0 || rows <= 0)
+			return;
+		across = t->get_width()/size;
+		if(across <= 0)
+			return;
+		/* Clip the map to the screen */
+		from = (x < 0) ? 0 : x;
+		to = x+cols*size;
+		if(to > Video::get_width())
+			to = Video::get_width();
+		top = (y < 0) ? 0 : y;
+		bottom = y+rows*size;
+		if(bottom > Video::get_height())
+			bottom = Video::get_height();
+		if(from >= to || top >= bottom)
+			return;
+		Video::mark_dirty(from,top,to-from,bottom-top);
+		for(sy = top;sy < bottom;sy++)
+		{
+			/* Row of tiles and row within them */
+			my = (sy-y)/size;
+			ty = (sy-y)%size;
+			line = &map[my*cols];
+			data = Video::get_span(from,sy,to-from);
+			/* Run along the row a tile at a time */
+			i = from;
+			while(i < to)
+			{
+				col = (i-x)/size;
+				tx = (i-x)%size;
+				n = size-tx;
+				if(i+n > to)
+					n = to-i;
+				tile = line[col];
+				if(tile >= 0)
+				{
+					src = &t->get_row((tile/across)*size+ty)[(tile%across)*size+tx];
+					copy_row(&data[i-from],src,n,flags);
+				}
+				i += n;
+			}
+			Video::put_span();
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+#ifndef SPRITE_H
+#define SPRITE_H
+
+/* Sprite flags */
+#define SPRITE_OPAQUE 0 /* Every pixel is copied */
+#define SPRITE_KEYED 1 /* Pixels with zero alpha are skipped */
+
+/* Includes */
+#include "draw.h"
+
+/* REMARKS: */
+/*
+	Sprites are axis aligned pieces of a texture copied to the screen at their own size,
+	for UI, HUDs and 2D backgrounds. Everything is clipped once per sprite (or tilemap row),
+	then copied a row at a time, opaque rows with memcpy and keyed rows with SSE masked copies.
+	Source rectangles are clipped to the texture, they never wrap.
+	A tilemap fetches each tile index once per row of pixels it covers, tiles are laid out
+	in rows across the texture and negative indices are left empty.
+*/
+
+/* One sprite of a batch */
+typedef struct
+{
+	int x; /* Location on screen */
+	int y;
+	int sx; /* Top left in the texture */
+	int sy;
+	int w; /* Size */
+	int h;
+	int flags; /* Sprite flags */
+}SpriteBlit;
+
+/* Sprite */
+namespace Sprite
+{
+	/*
+		Copies a row of pixels
+		d - destination
+		s - source
+		n - count of pixels
+		flags - sprite flags
+	*/
+	extern void copy_row(int *d,int *s,int n,int flags);
+	/*
+		Draws a sprite
+		x,y - location on screen
+		t - the texture
+		sx,sy - top left in the texture
+		w,h - size
+		flags - sprite flags
+	*/
+	extern void blit(int x,int y,Texture *t,int sx,int sy,int w,int h,int flags);
+	/*
+		Draws many sprites from one texture, in order
+		t - the texture
+		n - count of sprites
+		bs - the sprites
+	*/
+	extern void batch(Texture *t,int n,SpriteBlit *bs);
+	/*
+		Draws a tilemap layer
+		x,y - location of the top left of the map on screen (scroll by moving it)
+		t - texture holding the tiles
+		size - width and height of a tile (in pixels)
+		cols,rows - size of the map (in tiles)
+		map - tile index of every tile, row by row (negative for none)
+		flags - sprite flags
+	*/
+	extern void tilemap(int x,int y,Texture *t,int size,int cols,int rows,int *map,int flags);
+}
+
+#endif
\ No newline at end of file
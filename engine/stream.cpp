@@ -0,0 +1,351 @@
+/*
+	Stream - Loads assets in the background on a pool of worker threads
+*/
+
+/* Includes */
+#include <SDL.h>
+#include <string.h>
+#include "stream.h"
+#include "system.h"
+
+/* Stream */
+namespace Stream
+{
+	/* Globals */
+	SDL_Thread *stream_workers[STREAM_MAX_WORKERS]; /* Worker threads */
+	int stream_worker_count = 0; /* Count of running workers */
+	SDL_mutex *stream_lock = 0; /* Guards both queues and the quit flag */
+	SDL_cond *stream_signal = 0; /* Wakes workers when work is queued or on quit */
+	StreamRequest *stream_queue = 0; /* Requests waiting for a worker (first in line) */
+	StreamRequest *stream_queue_last = 0; /* .. last in line */
+	StreamRequest *stream_done = 0; /* Requests waiting to be finished (first in line) */
+	StreamRequest *stream_done_last = 0; /* .. last in line */
+	int stream_quit = 0; /* Workers should exit */
+	int stream_pending = 0; /* Requests not finished yet (main thread only) */
+	int stream_active = 0; /* Streaming started? */
+	/* Appends a request to a queue */
+	void enqueue(StreamRequest **first,StreamRequest **last,StreamRequest *r)
+	{
+		r->next = 0;
+		if(*last)
+			(*last)->next = r;
+		else
+			*first = r;
+		*last = r;
+	}
+	/* Removes the first request from a queue */
+	StreamRequest *dequeue(StreamRequest **first,StreamRequest **last)
+	{
+		StreamRequest *r;
+		r = *first;
+		if(!r)
+			return 0;
+		*first = r->next;
+		if(!*first)
+			*last = 0;
+		r->next = 0;
+		return r;
+	}
+	/* Checks for a valid texture size */
+	int valid_size(int s)
+	{
+		return s >= 8 && s <= 256 && !(s&(s-1));
+	}
+	/* Reads and decodes a texture into staging pixels */
+	void decode_texture(StreamRequest *r)
+	{
+		SDL_Surface *s,*c;
+		int y;
+		/* Read */
+		s = SDL_LoadBMP(r->path);
+		if(!s)
+		{
+			r->result = STREAM_OPEN_FAILURE;
+			return;
+		}
+		/* Convert to framebuffer channel order */
+		c = SDL_ConvertSurfaceFormat(s,SDL_PIXELFORMAT_ABGR8888,0);
+		SDL_FreeSurface(s);
+		if(!c)
+		{
+			r->result = STREAM_FORMAT_FAILURE;
+			return;
+		}
+		if(!valid_size(c->w) || !valid_size(c->h))
+		{
+			SDL_FreeSurface(c);
+			r->result = STREAM_FORMAT_FAILURE;
+			return;
+		}
+		/* Copy out rows */
+		r->width = c->w;
+		r->height = c->h;
+		r->pixels = new int[c->w*c->h];
+		SDL_LockSurface(c);
+		for(y = 0;y < c->h;y++)
+			memcpy(&r->pixels[y*c->w],(char*)c->pixels+y*c->pitch,c->w*sizeof(int));
+		SDL_UnlockSurface(c);
+		SDL_FreeSurface(c);
+	}
+	/* Maps a mesh and pages it in */
+	void decode_mesh(StreamRequest *r)
+	{
+		r->mesh = new Mesh();
+		r->result = r->mesh->load(r->path);
+		if(r->result < 0)
+		{
+			delete r->mesh;
+			r->mesh = 0;
+			if(r->result == MESH_OPEN_FAILURE)
+				r->result = STREAM_OPEN_FAILURE;
+			else
+				r->result = STREAM_FORMAT_FAILURE;
+			return;
+		}
+		r->mesh->prefault();
+	}
+	/* Worker thread */
+	int worker(void *data)
+	{
+		StreamRequest *r;
+		int skip;
+		SDL_LockMutex(stream_lock);
+		while(1)
+		{
+			/* Wait for work */
+			while(!stream_queue && !stream_quit)
+				SDL_CondWait(stream_signal,stream_lock);
+			if(stream_quit)
+				break;
+			r = dequeue(&stream_queue,&stream_queue_last);
+			skip = r->released;
+			SDL_UnlockMutex(stream_lock);
+			/* Load, unless nobody wants it anymore */
+			if(!skip)
+			{
+				if(r->type == STREAM_TEXTURE)
+					decode_texture(r);
+				else
+					decode_mesh(r);
+			}
+			/* Hand over to main thread */
+			SDL_LockMutex(stream_lock);
+			enqueue(&stream_done,&stream_done_last,r);
+		}
+		SDL_UnlockMutex(stream_lock);
+		return 0;
+	}
+	/* Deletes a request and anything it still owns */
+	void destroy(StreamRequest *r)
+	{
+		delete[] r->pixels;
+		delete r->texture;
+		delete r->mesh;
+		delete r;
+	}
+	/* Start workers */
+	int start(int workers)
+	{
+		int i;
+		/* Already started? */
+		if(stream_active)
+			return STREAM_ALREADY_STARTED;
+		/* Leave one processor for the game */
+		if(workers <= 0)
+			workers = SDL_GetCPUCount()-1;
+		if(workers < 1)
+			workers = 1;
+		if(workers > STREAM_MAX_WORKERS)
+			workers = STREAM_MAX_WORKERS;
+		/* Sync objects */
+		stream_lock = SDL_CreateMutex();
+		stream_signal = SDL_CreateCond();
+		if(!stream_lock || !stream_signal)
+		{
+			if(stream_lock) SDL_DestroyMutex(stream_lock);
+			if(stream_signal) SDL_DestroyCond(stream_signal);
+			stream_lock = 0;
+			stream_signal = 0;
+			return STREAM_THREAD_FAILURE;
+		}
+		/* Threads */
+		stream_quit = 0;
+		stream_active = 1;
+		stream_worker_count = 0;
+		for(i = 0;i < workers;i++)
+		{
+			stream_workers[i] = SDL_CreateThread(worker,"stream",0);
+			if(!stream_workers[i])
+			{
+				stop();
+				return STREAM_THREAD_FAILURE;
+			}
+			stream_worker_count++;
+		}
+		return 0;
+	}
+	/* Stop workers */
+	void stop()
+	{
+		StreamRequest *r;
+		int i;
+		/* Already stopped? */
+		if(!stream_active)
+			return;
+		/* Wake and join everyone */
+		SDL_LockMutex(stream_lock);
+		stream_quit = 1;
+		SDL_CondBroadcast(stream_signal);
+		SDL_UnlockMutex(stream_lock);
+		for(i = 0;i < stream_worker_count;i++)
+			SDL_WaitThread(stream_workers[i],0);
+		stream_worker_count = 0;
+		/* Drop leftovers, handles still held by the game become failed */
+		while((r = dequeue(&stream_queue,&stream_queue_last)) || (r = dequeue(&stream_done,&stream_done_last)))
+		{
+			if(r->released)
+			{
+				destroy(r);
+				continue;
+			}
+			delete[] r->pixels;
+			delete r->mesh;
+			r->pixels = 0;
+			r->mesh = 0;
+			r->result = STREAM_NOT_STARTED;
+			r->state = STREAM_FAILED;
+		}
+		stream_pending = 0;
+		/* Sync objects */
+		SDL_DestroyCond(stream_signal);
+		SDL_DestroyMutex(stream_lock);
+		stream_signal = 0;
+		stream_lock = 0;
+		stream_active = 0;
+	}
+	/* Queue a request */
+	StreamRequest *load(const char *path,int type)
+	{
+		StreamRequest *r;
+		if(!stream_active)
+			return 0;
+		/* New request */
+		r = new StreamRequest;
+		memset(r,0,sizeof(StreamRequest));
+		r->type = type;
+		r->state = STREAM_WAITING;
+		strncpy(r->path,path,STREAM_MAX_PATH-1);
+		/* Hand to workers */
+		stream_pending++;
+		SDL_LockMutex(stream_lock);
+		enqueue(&stream_queue,&stream_queue_last,r);
+		SDL_CondSignal(stream_signal);
+		SDL_UnlockMutex(stream_lock);
+		return r;
+	}
+	/* Queue a texture */
+	StreamRequest *load_texture(const char *path)
+	{
+		return load(path,STREAM_TEXTURE);
+	}
+	/* Queue a mesh */
+	StreamRequest *load_mesh(const char *path)
+	{
+		return load(path,STREAM_MESH);
+	}
+	/* Finishes a request on the main thread */
+	void finish(StreamRequest *r)
+	{
+		stream_pending--;
+		/* Nobody wants it */
+		if(r->released)
+		{
+			destroy(r);
+			return;
+		}
+		/* Failed in worker */
+		if(r->result < 0)
+		{
+			r->state = STREAM_FAILED;
+			return;
+		}
+		/* Textures are built from their staging pixels */
+		if(r->type == STREAM_TEXTURE)
+		{
+			r->texture = new Texture(r->width,r->height);
+			r->texture->set_data(r->pixels);
+			delete[] r->pixels;
+			r->pixels = 0;
+		}
+		r->state = STREAM_READY;
+	}
+	/* Finish loaded assets */
+	void update(int budget)
+	{
+		StreamRequest *r;
+		long long from;
+		if(!stream_active)
+			return;
+		from = System::get_micro();
+		while(1)
+		{
+			/* Next finished request */
+			SDL_LockMutex(stream_lock);
+			r = dequeue(&stream_done,&stream_done_last);
+			SDL_UnlockMutex(stream_lock);
+			if(!r)
+				break;
+			finish(r);
+			/* Out of time? */
+			if(System::get_micro()-from >= budget)
+				break;
+		}
+	}
+	/* Get state */
+	int get_state(StreamRequest *r)
+	{
+		return r->state;
+	}
+	/* Get result */
+	int get_result(StreamRequest *r)
+	{
+		return r->result;
+	}
+	/* Take texture */
+	Texture *get_texture(StreamRequest *r)
+	{
+		Texture *t;
+		t = r->texture;
+		r->texture = 0;
+		return t;
+	}
+	/* Take mesh */
+	Mesh *get_mesh(StreamRequest *r)
+	{
+		Mesh *m;
+		m = r->mesh;
+		r->mesh = 0;
+		return m;
+	}
+	/* Release a handle */
+	void release(StreamRequest *r)
+	{
+		if(!r)
+			return;
+		/* Already finished, drop it now */
+		if(r->state != STREAM_WAITING)
+		{
+			destroy(r);
+			return;
+		}
+		/* Still in flight, whoever holds it drops it */
+		SDL_LockMutex(stream_lock);
+		r->released = 1;
+		SDL_UnlockMutex(stream_lock);
+	}
+	/* Get pending count */
+	int get_pending()
+	{
+		return stream_pending;
+	}
+}
\ No newline at end of file
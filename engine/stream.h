@@ -0,0 +1,106 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+/* Defines */
+#define STREAM_MAX_WORKERS 8
+#define STREAM_MAX_PATH 256
+#define STREAM_DEFAULT_BUDGET 2000 /* Microseconds per frame spent finishing assets */
+
+/* Asset types */
+#define STREAM_TEXTURE 0
+#define STREAM_MESH 1
+
+/* Request states */
+#define STREAM_WAITING 0 /* Queued, being read or waiting to be finished */
+#define STREAM_READY 1 /* Asset can be used */
+#define STREAM_FAILED 2 /* Asset could not be loaded, see result */
+
+/* Error codes */
+#define STREAM_ALREADY_STARTED -1
+#define STREAM_THREAD_FAILURE -2
+#define STREAM_NOT_STARTED -3
+#define STREAM_OPEN_FAILURE -4
+#define STREAM_FORMAT_FAILURE -5
+
+/* Includes */
+#include "draw.h"
+#include "mesh.h"
+
+/* REMARKS: */
+/*
+	Workers do all the file reading and decoding (textures are BMP files decoded into staging pixels,
+	meshes are mapped and paged in), the main thread only finishes them inside Stream::update.
+	Finishing stops once the frame budget is used up, leftovers are finished on following frames.
+*/
+
+/* Asset request, its fields belong to the stream system and are read through Stream functions */
+typedef struct StreamRequest
+{
+	int type; /* Asset type */
+	int state; /* Request state (only changed by the main thread) */
+	int result; /* Result code once failed */
+	int released; /* Owner no longer wants the request */
+	char path[STREAM_MAX_PATH]; /* File to read */
+	int width; /* Decoded texture size */
+	int height;
+	int *pixels; /* Decoded texture staging pixels */
+	Texture *texture; /* Finished texture */
+	Mesh *mesh; /* Finished mesh */
+	struct StreamRequest *next; /* Next request in queue */
+}StreamRequest;
+
+/* Stream */
+namespace Stream
+{
+	/*
+		Starts the worker threads
+		Returns result code
+		workers - count of worker threads (0 picks from processor count)
+	*/
+	extern int start(int workers);
+	/*
+		Stops the worker threads, dropping anything that was not finished
+	*/
+	extern void stop();
+	/*
+		Queues an asset to be loaded in the background
+		Returns the request handle, or 0 if streaming is not started
+		path - the file to load
+	*/
+	extern StreamRequest *load_texture(const char *path);
+	extern StreamRequest *load_mesh(const char *path);
+	/*
+		Finishes loaded assets on the main thread, call once per frame
+		At least one asset is finished per call so streaming always makes progress
+		budget - time allowed (in microseconds)
+	*/
+	extern void update(int budget);
+	/*
+		Gets the state of a request
+		r - the request
+	*/
+	extern int get_state(StreamRequest *r);
+	/*
+		Gets the result code of a failed request
+		r - the request
+	*/
+	extern int get_result(StreamRequest *r);
+	/*
+		Gets the finished asset of a ready request, ownership passes to the caller
+		r - the request
+	*/
+	extern Texture *get_texture(StreamRequest *r);
+	extern Mesh *get_mesh(StreamRequest *r);
+	/*
+		Gives up a request handle, unclaimed assets are deleted
+		Requests still waiting are cancelled
+		r - the request
+	*/
+	extern void release(StreamRequest *r);
+	/*
+		Gets the count of requests that are not finished yet
+	*/
+	extern int get_pending();
+}
+
+#endif
\ No newline at end of file
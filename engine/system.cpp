@@ -18,4 +18,18 @@ namespace System
 		f = f/1000; /* Frequency is counts per second, we convert to ms */
 		return c/f; /* .. convert to current time in ms */
 	}
+	/* Get current microsecond tick */
+	long long get_micro()
+	{
+		Uint64 c,f;
+		c = SDL_GetPerformanceCounter();
+		f = SDL_GetPerformanceFrequency();
+		/* Split into whole seconds and remainder so the scaling cannot overflow */
+		return (long long)((c/f)*1000000+((c%f)*1000000)/f);
+	}
+	/* Sleep */
+	void sleep(int ms)
+	{
+		SDL_Delay(ms);
+	}
 }
\ No newline at end of file
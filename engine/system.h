@@ -24,6 +24,16 @@ namespace System
 		Only useful for basic benchmarking and not frame timing
 	*/
 	extern int get_tick();
+	/*
+		Gets the current system hardware counter time, in microseconds
+		Precise enough for timing work within a frame
+	*/
+	extern long long get_micro();
+	/*
+		Gives up the processor for a while, may oversleep by a millisecond or more
+		ms - time to sleep (in milliseconds)
+	*/
+	extern void sleep(int ms);
 }
 
 #endif
\ No newline at end of file
@@ -5,8 +5,12 @@
 /* Include */
 #include <math.h>
 #include <memory.h>
+#include <xmmintrin.h>
 #include "vector.h"
 
+/* Defines */
+#define VECTOR_PI 3.14159265358979f
+
 /* New vector */
 Vector :: Vector(float x,float y,float z,float w)
 {
@@ -131,47 +135,182 @@ void Vector :: multiply(Matrix *m)
 /* Multiply matrix */
 void Matrix :: multiply(Matrix *m)
 {
-	float x1,y1,z1,w1;
-	float x2,y2,z2,w2;
-	float x3,y3,z3,w3;
-	float x4,y4,z4,w4;
-	/* 0 */
-	x1 = get(0,0)*m->get(0,0)+get(0,1)*m->get(1,0)+get(0,2)*m->get(2,0)+get(0,3)*m->get(3,0);
-	y1 = get(1,0)*m->get(0,0)+get(1,1)*m->get(1,0)+get(1,2)*m->get(2,0)+get(1,3)*m->get(3,0);
-	z1 = get(2,0)*m->get(0,0)+get(2,1)*m->get(1,0)+get(2,2)*m->get(2,0)+get(2,3)*m->get(3,0);
-	w1 = get(3,0)*m->get(0,0)+get(3,1)*m->get(1,0)+get(3,2)*m->get(2,0)+get(3,3)*m->get(3,0);
-	/* 1 */
-	x2 = get(0,0)*m->get(0,1)+get(0,1)*m->get(1,1)+get(0,2)*m->get(2,1)+get(0,3)*m->get(3,1);
-	y2 = get(1,0)*m->get(0,1)+get(1,1)*m->get(1,1)+get(1,2)*m->get(2,1)+get(1,3)*m->get(3,1);
-	z2 = get(2,0)*m->get(0,1)+get(2,1)*m->get(1,1)+get(2,2)*m->get(2,1)+get(2,3)*m->get(3,1);
-	w2 = get(3,0)*m->get(0,1)+get(3,1)*m->get(1,1)+get(3,2)*m->get(2,1)+get(3,3)*m->get(3,1);
-	/* 2 */
-	x3 = get(0,0)*m->get(0,2)+get(0,1)*m->get(1,2)+get(0,2)*m->get(2,2)+get(0,3)*m->get(3,2);
-	y3 = get(1,0)*m->get(0,2)+get(1,1)*m->get(1,2)+get(1,2)*m->get(2,2)+get(1,3)*m->get(3,2);
-	z3 = get(2,0)*m->get(0,2)+get(2,1)*m->get(1,2)+get(2,2)*m->get(2,2)+get(2,3)*m->get(3,2);
-	w3 = get(3,0)*m->get(0,2)+get(3,1)*m->get(1,2)+get(3,2)*m->get(2,2)+get(3,3)*m->get(3,2);
-	/* 3 */
-	x4 = get(0,0)*m->get(0,3)+get(0,1)*m->get(1,3)+get(0,2)*m->get(2,3)+get(0,3)*m->get(3,3);
-	y4 = get(1,0)*m->get(0,3)+get(1,1)*m->get(1,3)+get(1,2)*m->get(2,3)+get(1,3)*m->get(3,3);
-	z4 = get(2,0)*m->get(0,3)+get(2,1)*m->get(1,3)+get(2,2)*m->get(2,3)+get(2,3)*m->get(3,3);
-	w4 = get(3,0)*m->get(0,3)+get(3,1)*m->get(1,3)+get(3,2)*m->get(2,3)+get(3,3)*m->get(3,3);
+	__m128 r0,r1,r2,r3,o[4];
+	int i;
+	/* Each row of the result is a mix of the rows of m */
+	r0 = _mm_loadu_ps(&m->data[0]);
+	r1 = _mm_loadu_ps(&m->data[4]);
+	r2 = _mm_loadu_ps(&m->data[8]);
+	r3 = _mm_loadu_ps(&m->data[12]);
+	for(i = 0;i < 4;i++)
+	{
+		o[i] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(data[i*4]),r0),_mm_mul_ps(_mm_set1_ps(data[i*4+1]),r1)),
+		                  _mm_add_ps(_mm_mul_ps(_mm_set1_ps(data[i*4+2]),r2),_mm_mul_ps(_mm_set1_ps(data[i*4+3]),r3)));
+	}
+	/* Update */
+	for(i = 0;i < 4;i++)
+		_mm_storeu_ps(&data[i*4],o[i]);
+}
+
+/* Multiply affine matrix */
+void Matrix :: multiply_affine(Matrix *m)
+{
+	__m128 r0,r1,r2,o[3];
+	int i;
+	/* The bottom row of m only carries translation through, and ours stays 0,0,0,1 */
+	r0 = _mm_loadu_ps(&m->data[0]);
+	r1 = _mm_loadu_ps(&m->data[4]);
+	r2 = _mm_loadu_ps(&m->data[8]);
+	for(i = 0;i < 3;i++)
+	{
+		o[i] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(data[i*4]),r0),_mm_mul_ps(_mm_set1_ps(data[i*4+1]),r1)),
+		                  _mm_add_ps(_mm_mul_ps(_mm_set1_ps(data[i*4+2]),r2),_mm_set_ps(data[i*4+3],0.0f,0.0f,0.0f)));
+	}
 	/* Update */
-	data[0] = x1;
-	data[1] = x2;
-	data[2] = x3;
-	data[3] = x4;
-	data[4] = y1;
-	data[5] = y2;
-	data[6] = y3;
-	data[7] = y4;
-	data[8] = z1;
-	data[9] = z2;
-	data[10] = z3;
-	data[11] = z4;
-	data[12] = w1;
-	data[13] = w2;
-	data[14] = w3;
-	data[15] = w4;
+	for(i = 0;i < 3;i++)
+		_mm_storeu_ps(&data[i*4],o[i]);
+}
+
+/* Multiply by translation */
+void Matrix :: multiply_translate(float x,float y,float z)
+{
+	int i;
+	for(i = 0;i < 16;i += 4)
+		data[i+3] += data[i]*x+data[i+1]*y+data[i+2]*z;
+}
+
+/* Multiply by scale */
+void Matrix :: multiply_scale(float sx,float sy,float sz)
+{
+	int i;
+	for(i = 0;i < 16;i += 4)
+	{
+		data[i] *= sx;
+		data[i+1] *= sy;
+		data[i+2] *= sz;
+	}
+}
+
+/* Check affine */
+int Matrix :: is_affine()
+{
+	return data[12] == 0.0f && data[13] == 0.0f && data[14] == 0.0f && data[15] == 1.0f;
+}
+
+/* Transform points */
+void Matrix :: transform_points(int n,float *ps,float *out)
+{
+	__m128 c0,c1,c2,c3;
+	int i;
+	/* Columns of the matrix, so each point is three multiply-adds */
+	c0 = _mm_setr_ps(data[0],data[4],data[8],data[12]);
+	c1 = _mm_setr_ps(data[1],data[5],data[9],data[13]);
+	c2 = _mm_setr_ps(data[2],data[6],data[10],data[14]);
+	c3 = _mm_setr_ps(data[3],data[7],data[11],data[15]);
+	for(i = 0;i < n;i++)
+	{
+		_mm_storeu_ps(out,_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(ps[0]),c0),_mm_mul_ps(_mm_set1_ps(ps[1]),c1)),
+		                             _mm_add_ps(_mm_mul_ps(_mm_set1_ps(ps[2]),c2),c3)));
+		ps += 3;
+		out += 4;
+	}
+}
+
+/* Rotation matrix */
+void Matrix :: rotate(float angle,float x,float y,float z)
+{
+	float c,s,t,l;
+	/* Normalize axis */
+	l = (float)sqrt(x*x+y*y+z*z);
+	identity();
+	if(l == 0.0f)
+		return;
+	x /= l;
+	y /= l;
+	z /= l;
+	/* Build */
+	angle *= VECTOR_PI/180.0f;
+	c = (float)cos(angle);
+	s = (float)sin(angle);
+	t = 1.0f-c;
+	data[0] = t*x*x+c;
+	data[1] = t*x*y-s*z;
+	data[2] = t*x*z+s*y;
+	data[4] = t*x*y+s*z;
+	data[5] = t*y*y+c;
+	data[6] = t*y*z-s*x;
+	data[8] = t*x*z-s*y;
+	data[9] = t*y*z+s*x;
+	data[10] = t*z*z+c;
+}
+
+/* Perspective matrix */
+void Matrix :: perspective(float fov,float znear,float zfar)
+{
+	float f;
+	memset(data,0,sizeof(data));
+	f = 1.0f/(float)tan(fov*VECTOR_PI/360.0f);
+	data[0] = f;
+	data[5] = f;
+	data[10] = (zfar+znear)/(znear-zfar);
+	data[11] = (2.0f*zfar*znear)/(znear-zfar);
+	data[14] = -1.0f;
+}
+
+/* Orthographic matrix */
+void Matrix :: orthographic(float l,float r,float b,float t,float znear,float zfar)
+{
+	identity();
+	data[0] = 2.0f/(r-l);
+	data[3] = -(r+l)/(r-l);
+	data[5] = 2.0f/(t-b);
+	data[7] = -(t+b)/(t-b);
+	data[10] = -2.0f/(zfar-znear);
+	data[11] = -(zfar+znear)/(zfar-znear);
+}
+
+/* Look at matrix */
+void Matrix :: look_at(float ex,float ey,float ez,float tx,float ty,float tz,float ux,float uy,float uz)
+{
+	float fx,fy,fz,sx,sy,sz,l;
+	/* Forward */
+	fx = tx-ex;
+	fy = ty-ey;
+	fz = tz-ez;
+	l = (float)sqrt(fx*fx+fy*fy+fz*fz);
+	if(l == 0.0f)
+		l = 1.0f;
+	fx /= l;
+	fy /= l;
+	fz /= l;
+	/* Side is forward cross up */
+	sx = fy*uz-fz*uy;
+	sy = fz*ux-fx*uz;
+	sz = fx*uy-fy*ux;
+	l = (float)sqrt(sx*sx+sy*sy+sz*sz);
+	if(l == 0.0f)
+		l = 1.0f;
+	sx /= l;
+	sy /= l;
+	sz /= l;
+	/* True up is side cross forward */
+	ux = sy*fz-sz*fy;
+	uy = sz*fx-sx*fz;
+	uz = sx*fy-sy*fx;
+	/* Build */
+	identity();
+	data[0] = sx;
+	data[1] = sy;
+	data[2] = sz;
+	data[3] = -(sx*ex+sy*ey+sz*ez);
+	data[4] = ux;
+	data[5] = uy;
+	data[6] = uz;
+	data[7] = -(ux*ex+uy*ey+uz*ez);
+	data[8] = -fx;
+	data[9] = -fy;
+	data[10] = -fz;
+	data[11] = fx*ex+fy*ey+fz*ez;
 }
 
 /* Translate matrix */
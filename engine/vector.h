@@ -102,6 +102,54 @@ public:
 		Sets this matrix equal to given
 	*/
 	void set(Matrix *m);
+	/*
+		Sets this matrix to a rotation around an axis
+		angle - rotation (in degrees)
+		x,y,z - axis to rotate around (does not need to be normalized)
+	*/
+	void rotate(float angle,float x,float y,float z);
+	/*
+		Sets this matrix to a perspective projection (OpenGL style, camera looking down -z)
+		fov - vertical field of view (in degrees)
+		znear,zfar - distance to near and far planes
+	*/
+	void perspective(float fov,float znear,float zfar);
+	/*
+		Sets this matrix to an orthographic projection (OpenGL style)
+		l,r,b,t - left, right, bottom and top of view volume
+		znear,zfar - distance to near and far planes
+	*/
+	void orthographic(float l,float r,float b,float t,float znear,float zfar);
+	/*
+		Sets this matrix to a view from a camera position towards a target
+		ex,ey,ez - camera position
+		tx,ty,tz - point to look at
+		ux,uy,uz - which way is up
+	*/
+	void look_at(float ex,float ey,float ez,float tx,float ty,float tz,float ux,float uy,float uz);
+	/*
+		Multiplies this matrix with the given one when both are affine (bottom row 0,0,0,1)
+		Much cheaper than multiply
+	*/
+	void multiply_affine(Matrix *m);
+	/*
+		Multiplies this matrix with a translation or scale without building it
+		x,y,z - amount to translate to
+		sx,sy,sz - factor to scale to in each dimension
+	*/
+	void multiply_translate(float x,float y,float z);
+	void multiply_scale(float sx,float sy,float sz);
+	/*
+		Checks if this matrix is affine (bottom row 0,0,0,1)
+	*/
+	int is_affine();
+	/*
+		Transforms an array of points with this matrix
+		n - count of points
+		ps - the points (3 floats each, w is taken as 1)
+		out - transformed points (4 floats each)
+	*/
+	void transform_points(int n,float *ps,float *out);
 };
 
 #endif
\ No newline at end of file
@@ -4,9 +4,13 @@
 
 /* Includes */
 #include <SDL.h>
+#include <memory.h>
+#include <emmintrin.h>
 #include "video.h"
 #include "draw.h"
 #include "geo.h"
+#include "occlusion.h"
+#include "post.h"
 
 /* Video */
 namespace Video
@@ -20,8 +24,22 @@ namespace Video
 	int window_scale = VIDEO_DEFAULT_SCALE; /* Default screen scale of display (player gets to set this themselves typically) */
 	int active = 0; /* If the video system is active */
 	int drawing = 0; /* If the video system is now drawing a frame */
-	int surface_pitch = 0; /* Width of a scanline on surface (in ints) */
+	int surface_pitch = 0; /* Width of a scanline on surface (in pixels) */
 	int *surface_pixels = 0; /* Pointer to actual surface pixels */
+	unsigned short *surface_pixels15 = 0; /* .. when they are 15-bit */
+	int format = VIDEO_FORMAT_32; /* Framebuffer format */
+	int *span_buffer = 0; /* Scratch scanline for get_span with 15-bit format */
+	int span_x = 0; /* Location of open span */
+	int span_y = 0;
+	int span_n = 0;
+	int dither[4][4] = {{-4,0,-3,1},{2,-2,3,-1},{-3,1,-4,0},{3,-1,2,-2}}; /* PSX ordered dither offsets */
+	Arena *arena = 0; /* Frame arena for transient allocations */
+	int arena_size = VIDEO_DEFAULT_ARENA; /* Size of frame arena */
+	int dirty_mode = 0; /* Only clear and present what was drawn? */
+	int dirty_full = 1; /* Next frame must clear and present everything */
+	SDL_Rect dirty_rects[2][VIDEO_MAX_DIRTY]; /* Areas drawn in each of the last two frames */
+	int dirty_counts[2] = {0,0}; /* .. and how many */
+	int dirty_frame = 0; /* Which of the two lists is this frame */
 	/* Set internal resolution */
 	void set_resolution(int w,int h)
 	{
@@ -32,6 +50,29 @@ namespace Video
 		internal_width = w;
 		internal_height = h;
 	}
+	/* Set arena size */
+	void set_arena_size(int s)
+	{
+		/* Cannot be done while video is active */
+		if(active)
+			return;
+		/* Set */
+		arena_size = s;
+	}
+	/* Set format */
+	void set_format(int f)
+	{
+		/* Cannot be done while video is active */
+		if(active)
+			return;
+		/* Set */
+		format = f;
+	}
+	/* Get format */
+	int get_format()
+	{
+		return format;
+	}
 	/* Start video */
 	int start()
 	{
@@ -50,12 +91,17 @@ namespace Video
 		if(!screen)
 			return VIDEO_SCREEN_FAILURE;
 		/* Create surface */
-		surface = SDL_CreateRGBSurface(0,internal_width,internal_height,32,VIDEO_MASK_RED,VIDEO_MASK_GREEN,VIDEO_MASK_BLUE,VIDEO_MASK_EXTRA);
+		if(format == VIDEO_FORMAT_15)
+			surface = SDL_CreateRGBSurface(0,internal_width,internal_height,16,VIDEO_MASK15_RED,VIDEO_MASK15_GREEN,VIDEO_MASK15_BLUE,0);
+		else
+			surface = SDL_CreateRGBSurface(0,internal_width,internal_height,32,VIDEO_MASK_RED,VIDEO_MASK_GREEN,VIDEO_MASK_BLUE,VIDEO_MASK_EXTRA);
 		if(!surface)
 			return VIDEO_SURFACE_FAILURE;
+		/* Scratch scanline */
+		span_buffer = new int[internal_width];
 		SDL_SetSurfaceBlendMode(surface,SDL_BLENDMODE_NONE); /* We don't want SDL to blend the surface used as framebuffer */
-		/* Calculate blend LUT */
-		Draw::calculate_multiply();
+		/* Create frame arena */
+		arena = new Arena(arena_size);
 		/* Initialize geo render */
 		Geo::init();
 		/* Ready */
@@ -70,8 +116,13 @@ namespace Video
 			return;
 		/* End geo render */
 		Geo::exit();
+		/* Remove frame arena */
+		delete arena;
+		arena = 0;
 		/* Remove surface */
 		SDL_FreeSurface(surface);
+		delete[] span_buffer;
+		span_buffer = 0;
 		/* Remove window */
 		SDL_DestroyWindow(window);
 		/* Stop SDL */
@@ -92,45 +143,302 @@ namespace Video
 			/* User clicked the X on the window typically, or system posted a quit message */
 			if(ev.type == SDL_QUIT)
 				ret = 0;
+			/* Window contents were lost, dirty mode has to present everything again */
+			if(ev.type == SDL_WINDOWEVENT)
+				dirty_full = 1;
 		}
 		return ret;
 	}
 	/* Begins a new frame */
 	int begin()
 	{
+		int i;
 		/* Already drawing? */
 		if(drawing)
 			return VIDEO_ALREADY_STARTED;
-		/* Blank out internal surface */
-		if(SDL_FillRect(surface,0,0))
+		/* Release last frame's transient memory */
+		arena->reset();
+		/* Blank out internal surface, in dirty mode only what the last frame drew is not blank already */
+		if(dirty_mode && !dirty_full)
+		{
+			for(i = 0;i < dirty_counts[dirty_frame];i++)
+			{
+				if(SDL_FillRect(surface,&dirty_rects[dirty_frame][i],0))
+					return VIDEO_FILL_FAILURE;
+			}
+		}
+		else if(SDL_FillRect(surface,0,0))
 			return VIDEO_FILL_FAILURE;
+		/* Start tracking this frame */
+		dirty_frame ^= 1;
+		dirty_counts[dirty_frame] = 0;
 		/* Lock surface */
 		if(SDL_LockSurface(surface))
 			return VIDEO_LOCK_FAILURE;
-		surface_pitch = surface->pitch/4;
+		surface_pitch = surface->pitch/surface->format->BytesPerPixel;
 		surface_pixels = (int*)surface->pixels;
+		surface_pixels15 = (unsigned short*)surface->pixels;
 		/* Ready */
 		Draw::reset_pixels_filled();
+		Geo::reset_culled();
+		Occlusion::clear();
 		drawing = 1;
 		return 0;
 	}
+	/* Adds an area to a dirty list, merging it into whatever it touches */
+	void add_rect(SDL_Rect *list,int *count,int x1,int y1,int x2,int y2)
+	{
+		SDL_Rect *r;
+		int i,best,grow,least,rx2,ry2;
+		/* Merge with any rectangle it touches */
+		for(i = 0;i < count[0];i++)
+		{
+			r = &list[i];
+			rx2 = r->x+r->w;
+			ry2 = r->y+r->h;
+			if(x1 <= rx2 && x2 >= r->x && y1 <= ry2 && y2 >= r->y)
+				break;
+		}
+		/* No room, merge with whichever grows the least */
+		if(i == count[0] && count[0] == VIDEO_MAX_DIRTY)
+		{
+			best = 0;
+			least = 0x7FFFFFFF;
+			for(i = 0;i < count[0];i++)
+			{
+				r = &list[i];
+				rx2 = (r->x+r->w > x2) ? r->x+r->w : x2;
+				ry2 = (r->y+r->h > y2) ? r->y+r->h : y2;
+				grow = (rx2-((r->x < x1) ? r->x : x1))*(ry2-((r->y < y1) ? r->y : y1))-r->w*r->h;
+				if(grow < least)
+				{
+					least = grow;
+					best = i;
+				}
+			}
+			i = best;
+		}
+		/* New rectangle */
+		if(i == count[0])
+		{
+			r = &list[count[0]++];
+			r->x = x1;
+			r->y = y1;
+			r->w = x2-x1;
+			r->h = y2-y1;
+			return;
+		}
+		/* Grow existing one */
+		r = &list[i];
+		rx2 = (r->x+r->w > x2) ? r->x+r->w : x2;
+		ry2 = (r->y+r->h > y2) ? r->y+r->h : y2;
+		if(x1 < r->x) r->x = x1;
+		if(y1 < r->y) r->y = y1;
+		r->w = rx2-r->x;
+		r->h = ry2-r->y;
+	}
+	/* Copies and presents only what was drawn this frame and the last */
+	int present_dirty()
+	{
+		SDL_Rect area[VIDEO_MAX_DIRTY];
+		SDL_Rect scaled[VIDEO_MAX_DIRTY];
+		SDL_Rect *r;
+		int i,n;
+		/* Combine both frames */
+		n = 0;
+		for(i = 0;i < dirty_counts[dirty_frame];i++)
+		{
+			r = &dirty_rects[dirty_frame][i];
+			add_rect(area,&n,r->x,r->y,r->x+r->w,r->y+r->h);
+		}
+		for(i = 0;i < dirty_counts[dirty_frame^1];i++)
+		{
+			r = &dirty_rects[dirty_frame^1][i];
+			add_rect(area,&n,r->x,r->y,r->x+r->w,r->y+r->h);
+		}
+		/* Nothing changed at all */
+		if(!n)
+			return 0;
+		/* Copy each area */
+		for(i = 0;i < n;i++)
+		{
+			scaled[i].x = area[i].x*window_scale;
+			scaled[i].y = area[i].y*window_scale;
+			scaled[i].w = area[i].w*window_scale;
+			scaled[i].h = area[i].h*window_scale;
+			if(SDL_BlitScaled(surface,&area[i],screen,&scaled[i]))
+				return VIDEO_FILL_FAILURE;
+		}
+		/* Show */
+		SDL_UpdateWindowSurfaceRects(window,scaled,n);
+		return 0;
+	}
 	/* Ends the frame and displays result */
 	int end()
 	{
 		/* Not drawing */
 		if(!drawing)
 			return VIDEO_ALREADY_ENDED;
+		/* Post-processing */
+		Post::apply();
 		/* Unlock */
 		SDL_UnlockSurface(surface);
 		/* Transfer to main window */
-		if(SDL_BlitScaled(surface,0,screen,0))
-			return VIDEO_FILL_FAILURE;
-		/* Show */
-		SDL_UpdateWindowSurface(window);
+		if(dirty_mode && !dirty_full)
+		{
+			if(present_dirty())
+				return VIDEO_FILL_FAILURE;
+		}
+		else
+		{
+			if(SDL_BlitScaled(surface,0,screen,0))
+				return VIDEO_FILL_FAILURE;
+			/* Show */
+			SDL_UpdateWindowSurface(window);
+			dirty_full = 0;
+		}
 		/* Ready */
 		drawing = 0;
 		return 0;
 	}
+	/* Sets dirty mode */
+	void set_dirty_mode(int d)
+	{
+		dirty_mode = d;
+		dirty_full = 1;
+	}
+	/* Marks an area as drawn */
+	void mark_dirty(int x,int y,int w,int h)
+	{
+		int x2,y2;
+		if(!dirty_mode)
+			return;
+		/* Clip */
+		x2 = x+w;
+		y2 = y+h;
+		if(x < 0) x = 0;
+		if(y < 0) y = 0;
+		if(x2 > internal_width) x2 = internal_width;
+		if(y2 > internal_height) y2 = internal_height;
+		if(x >= x2 || y >= y2)
+			return;
+		/* Add */
+		add_rect(dirty_rects[dirty_frame],&dirty_counts[dirty_frame],x,y,x2,y2);
+	}
+	/* Marks everything as drawn */
+	void mark_all_dirty()
+	{
+		mark_dirty(0,0,internal_width,internal_height);
+	}
+	/* Expands a 15-bit pixel to the middle of its range */
+	inline int expand(int p)
+	{
+		return ((p&0x001F)<<3)|((p&0x03E0)<<6)|((p&0x7C00)<<9)|0x040404;
+	}
+	/* Dithers a pixel down to 15 bits */
+	inline int pack(int c,int d)
+	{
+		int r,g,b;
+		r = (c&0xFF)+d;
+		g = ((c>>8)&0xFF)+d;
+		b = ((c>>16)&0xFF)+d;
+		if(r < 0) r = 0; else if(r > 255) r = 255;
+		if(g < 0) g = 0; else if(g > 255) g = 255;
+		if(b < 0) b = 0; else if(b > 255) b = 255;
+		return (r>>3)|((g>>3)<<5)|((b>>3)<<10);
+	}
+	/* Reads a run of pixels */
+	void read_span(int x,int y,int n,int *buf)
+	{
+		unsigned short *src;
+		__m128i v,mr,mg,mb,mid;
+		int i;
+		/* Already 32-bit */
+		if(format != VIDEO_FORMAT_15)
+		{
+			memcpy(buf,&surface_pixels[x+y*surface_pitch],n*sizeof(int));
+			return;
+		}
+		/* Expand four at a time */
+		src = &surface_pixels15[x+y*surface_pitch];
+		mr = _mm_set1_epi32(0x001F);
+		mg = _mm_set1_epi32(0x03E0);
+		mb = _mm_set1_epi32(0x7C00);
+		mid = _mm_set1_epi32(0x040404);
+		for(i = 0;i+4 <= n;i += 4)
+		{
+			v = _mm_unpacklo_epi16(_mm_loadl_epi64((__m128i*)&src[i]),_mm_setzero_si128());
+			v = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(_mm_and_si128(v,mr),3),_mm_slli_epi32(_mm_and_si128(v,mg),6)),
+			                 _mm_or_si128(_mm_slli_epi32(_mm_and_si128(v,mb),9),mid));
+			_mm_storeu_si128((__m128i*)&buf[i],v);
+		}
+		for(;i < n;i++)
+			buf[i] = expand(src[i]);
+	}
+	/* Writes a run of pixels */
+	void write_span(int x,int y,int n,int *buf)
+	{
+		unsigned short *dst;
+		__m128i v,up,down,mr,mg,mb;
+		int i,d,k,o[4];
+		/* Already 32-bit */
+		if(format != VIDEO_FORMAT_15)
+		{
+			memcpy(&surface_pixels[x+y*surface_pitch],buf,n*sizeof(int));
+			return;
+		}
+		dst = &surface_pixels15[x+y*surface_pitch];
+		/* Dither offsets for four pixels in a row starting at x, split into saturating add and subtract */
+		for(k = 0;k < 4;k++)
+		{
+			d = dither[y&3][(x+k)&3];
+			o[k] = (d > 0) ? d*0x010101 : 0;
+		}
+		up = _mm_setr_epi32(o[0],o[1],o[2],o[3]);
+		for(k = 0;k < 4;k++)
+		{
+			d = dither[y&3][(x+k)&3];
+			o[k] = (d < 0) ? -d*0x010101 : 0;
+		}
+		down = _mm_setr_epi32(o[0],o[1],o[2],o[3]);
+		mr = _mm_set1_epi32(0x001F);
+		mg = _mm_set1_epi32(0x03E0);
+		mb = _mm_set1_epi32(0x7C00);
+		/* Dither and pack four at a time */
+		for(i = 0;i+4 <= n;i += 4)
+		{
+			v = _mm_subs_epu8(_mm_adds_epu8(_mm_loadu_si128((__m128i*)&buf[i]),up),down);
+			v = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_srli_epi32(v,3),mr),_mm_and_si128(_mm_srli_epi32(v,6),mg)),
+			                 _mm_and_si128(_mm_srli_epi32(v,9),mb));
+			_mm_storel_epi64((__m128i*)&dst[i],_mm_packs_epi32(v,v));
+		}
+		for(;i < n;i++)
+			dst[i] = pack(buf[i],dither[y&3][(x+i)&3]);
+	}
+	/* Opens a span */
+	int *get_span(int x,int y,int n)
+	{
+		/* Direct access */
+		if(format != VIDEO_FORMAT_15)
+			return &surface_pixels[x+y*surface_pitch];
+		/* Expand into scratch */
+		if(n < 0)
+			n = 0;
+		span_x = x;
+		span_y = y;
+		span_n = n;
+		if(n)
+			read_span(x,y,n,span_buffer);
+		return span_buffer;
+	}
+	/* Closes a span */
+	void put_span()
+	{
+		if(format != VIDEO_FORMAT_15 || !span_n)
+			return;
+		write_span(span_x,span_y,span_n,span_buffer);
+		span_n = 0;
+	}
 	/* Sets a pixel on the framebuffer */
 	void set_pixel(int x,int y,int c)
 	{
@@ -140,7 +448,10 @@ namespace Video
 		if(y < 0 || y >= internal_height)
 			return;
 		/* Set at position */
-		surface_pixels[x+y*surface_pitch] = c;
+		if(format == VIDEO_FORMAT_15)
+			write_span(x,y,1,&c);
+		else
+			surface_pixels[x+y*surface_pitch] = c;
 	}
 	/* Gets a pixel on the framebuffer */
 	int get_pixel(int x,int y)
@@ -151,8 +462,20 @@ namespace Video
 		if(y < 0 || y >= internal_height)
 			return 0;
 		/* Get */
+		if(format == VIDEO_FORMAT_15)
+			return expand(surface_pixels15[x+y*surface_pitch]);
 		return surface_pixels[x+y*surface_pitch];
 	}
+	/* Gets frame arena */
+	Arena *get_arena()
+	{
+		return arena;
+	}
+	/* Allocates from frame arena */
+	void *frame_alloc(int s)
+	{
+		return arena->alloc(s);
+	}
 	/* Gets internal width */
 	int get_width()
 	{
@@ -5,6 +5,8 @@
 #define VIDEO_DEFAULT_WIDTH 320
 #define VIDEO_DEFAULT_HEIGHT 240
 #define VIDEO_DEFAULT_SCALE 2
+#define VIDEO_DEFAULT_ARENA 1048576 /* Bytes of transient memory per frame */
+#define VIDEO_MAX_DIRTY 32 /* Dirty rectangles tracked per frame before they get merged */
 
 /* Color channel masks */
 #define VIDEO_MASK_RED   0x000000FF
@@ -12,6 +14,15 @@
 #define VIDEO_MASK_BLUE  0x00FF0000
 #define VIDEO_MASK_EXTRA 0xFF000000
 
+/* Color channel masks (15-bit format) */
+#define VIDEO_MASK15_RED   0x001F
+#define VIDEO_MASK15_GREEN 0x03E0
+#define VIDEO_MASK15_BLUE  0x7C00
+
+/* Framebuffer formats */
+#define VIDEO_FORMAT_32 0 /* 32-bit pixels, drawn as they are */
+#define VIDEO_FORMAT_15 1 /* 16-bit RGB555 pixels with 4x4 ordered dithering like the PSX */
+
 /* Error codes */
 #define VIDEO_ALREADY_STARTED -1
 #define VIDEO_SDL_FAILURE -2
@@ -22,6 +33,17 @@
 #define VIDEO_ALREADY_ENDED -7
 #define VIDEO_SCREEN_FAILURE -8
 
+/* Includes */
+#include "arena.h"
+
+/* REMARKS: */
+/*
+	With VIDEO_FORMAT_15 every pixel is stored as RGB555, halving the memory traffic of clearing,
+	blending and copying to the window. Pixels are dithered with the PSX 4x4 matrix as they are stored.
+	Stored pixels read back at the middle of their 5-bit step with zero alpha,
+	so storing back a pixel that was not changed always gives the same 5-bit value.
+*/
+
 /* Video */
 namespace Video
 {
@@ -30,6 +52,20 @@ namespace Video
 		w,h - the new resolution
 	*/
 	extern void set_resolution(int w,int h);
+	/*
+		Changes the size of the frame arena (only when video system is not active)
+		s - size of arena (in bytes)
+	*/
+	extern void set_arena_size(int s);
+	/*
+		Changes the framebuffer format (only when video system is not active)
+		f - the format
+	*/
+	extern void set_format(int f);
+	/*
+		Gets the framebuffer format
+	*/
+	extern int get_format();
 	/*
 		Starts the video system which also displays the game window
 		Returns result code
@@ -54,6 +90,24 @@ namespace Video
 		Returns result code
 	*/
 	extern int end();
+	/*
+		Turns dirty rectangle mode on or off
+		In dirty mode only the areas drawn this frame or the last one are cleared, copied and presented,
+		so frames that change little cost little
+		d - 1 to turn on, 0 to turn off
+	*/
+	extern void set_dirty_mode(int d);
+	/*
+		Marks an area as drawn this frame, areas are clipped to the framebuffer
+		Drawing functions call this themselves, it only matters in dirty mode
+		x,y - top left of area (internal)
+		w,h - size of area
+	*/
+	extern void mark_dirty(int x,int y,int w,int h);
+	/*
+		Marks the whole framebuffer as drawn this frame
+	*/
+	extern void mark_all_dirty();
 	/*
 		Sets a pixel on framebuffer while drawing a frame
 		x,y - pixel coordinate (internal)
@@ -67,9 +121,49 @@ namespace Video
 	extern int get_pixel(int x,int y);
 	/*
 		Gets a direct pointer to framebuffer data starting at a location for sequential access
+		Only valid with the 32-bit format, use get_span to support every format
 		x,y - location to start from
 	*/
 	extern int *get_data(int x,int y);
+	/*
+		Gets a run of framebuffer pixels as 32-bit pixels for reading and writing
+		With the 32-bit format this points into the framebuffer itself,
+		otherwise the run is expanded into a scratch buffer and put_span must be called to store it back
+		Only one span can be open at a time
+		x,y - location to start from
+		n - count of pixels (must stay within the scanline)
+	*/
+	extern int *get_span(int x,int y,int n);
+	/*
+		Stores the span from get_span back into the framebuffer (dithering as needed)
+	*/
+	extern void put_span();
+	/*
+		Reads a run of framebuffer pixels into a buffer as 32-bit pixels
+		Safe to use from several threads on different runs
+		x,y - location to start from
+		n - count of pixels (must stay within the scanline)
+		buf - output pixels
+	*/
+	extern void read_span(int x,int y,int n,int *buf);
+	/*
+		Writes a run of 32-bit pixels into the framebuffer (dithering as needed)
+		Safe to use from several threads on different runs
+		x,y - location to start from
+		n - count of pixels (must stay within the scanline)
+		buf - the pixels
+	*/
+	extern void write_span(int x,int y,int n,int *buf);
+	/*
+		Gets the frame arena, everything allocated from it is released by the next begin
+	*/
+	extern Arena *get_arena();
+	/*
+		Allocates transient memory that lives until the next frame begins
+		Returns 0 if the frame arena is full
+		s - size of memory (in bytes)
+	*/
+	extern void *frame_alloc(int s);
 	/*
 		Gets the internal resolution of video
 	*/